@@ -0,0 +1,137 @@
+#include <stdint-gcc.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "board_annotate.hpp"
+
+// Checks the annotator against hand labelled screenshots and times it:
+//   build/annotate_check [--reps N] image.png image.labels [image labels ...]
+// Each image is classified three ways: every cell from every pixel (as
+// --full-res), the fast path (the lattice, then the unsure cells from
+// every pixel) and the lattice alone, with the confidence gate off so
+// every lattice label is kept. For each it prints the mean ms of decode
+// and classify over the repetitions and every cell whose label differs
+// from the labels file, one line of RGBY per board row. Cells the lattice
+// alone gets wrong but the fast path gets right are the ones the gate
+// caught. Exits with 1 if the full or fast path has a wrong cell.
+
+static const char* LETTERS = "-RGBY";
+
+// Rows of "RGBY" letters, skipping blank lines and lines starting with '#'.
+static bool readLabels(const std::string& path, const Annotator::Params& P, std::vector<uint8_t>& labels) {
+    std::ifstream in(path);
+    std::string text;
+    labels.clear();
+    while (std::getline(in, text)) {
+        if (text.empty() || text[0] == '#') {
+            continue;
+        }
+        if (int(text.size()) != P.cols) {
+            return false;
+        }
+        for (char ch : text) {
+            const char* at = std::find(LETTERS + 1, LETTERS + 5, ch);
+            if (at == LETTERS + 5) {
+                return false;
+            }
+            labels.push_back(uint8_t(at - LETTERS));
+        }
+    }
+    return int(labels.size()) == P.rows * P.cols;
+}
+
+struct Run {
+    std::vector<uint8_t> labels;
+    double decodeMs = 0;
+    double classifyMs = 0; // with the fast path, including the unsure cells
+    double unsure = 0;     // cells classified again from every pixel, per run
+};
+
+static Run classify(const std::string& image, const Annotator::Params& P, int reps) {
+    Run run;
+    run.labels.resize(P.rows * P.cols);
+    for (int rep = 0; rep < reps; rep++) {
+        Annotator::Timings t;
+        Annotator::analyzeImageInto(image, P, Annotator::CellGrid{run.labels.data(), P.cols, 1}, &t);
+        run.decodeMs += t.decodeMs / reps;
+        run.classifyMs += (t.classifyMs + t.fallbackMs) / reps;
+        run.unsure += double(t.fallbackCells) / reps;
+    }
+    return run;
+}
+
+// Prints run's line and its wrong cells; returns how many there are.
+static int report(const char* name, const Run& run, const std::vector<uint8_t>& expected,
+                  const Annotator::Params& P) {
+    int wrong = 0;
+    std::string cells;
+    for (int i = 0; i < P.rows * P.cols; i++) {
+        if (run.labels[i] != expected[i]) {
+            wrong++;
+            cells += " (" + std::to_string(i / P.cols) + "," + std::to_string(i % P.cols) + ") "
+                   + LETTERS[run.labels[i]] + " for " + LETTERS[expected[i]];
+        }
+    }
+    std::cout << "  " << name << ": decode " << run.decodeMs << " ms, classify " << run.classifyMs << " ms";
+    if (run.unsure > 0) {
+        std::cout << ", " << run.unsure << " cells at full resolution";
+    }
+    std::cout << ", " << wrong << " wrong" << cells << "\n";
+    return wrong;
+}
+
+int main(int argc, char** argv) {
+    int reps = 20;
+    std::vector<std::string> files;
+    // Numbers that do not parse end up in the catch below.
+    int i = 1;
+    try {
+        for (; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (arg == "--reps" && i + 1 < argc) {
+                reps = std::max(1, std::stoi(argv[++i]));
+            } else {
+                files.push_back(arg);
+            }
+        }
+    } catch (const std::exception&) {
+        std::cerr << "Bad value for " << argv[i - 1] << ": " << argv[i] << "\n";
+        files.clear();
+    }
+    if (files.empty() || files.size() % 2) {
+        std::cerr << "Usage: " << argv[0] << " [--reps N] <image> <labels> [<image> <labels> ...]\n";
+        return 1;
+    }
+
+    Annotator::Params full;
+    full.fast = false;
+    const Annotator::Params fast;
+    Annotator::Params lattice;
+    lattice.minConfidence = 0;
+    lattice.minMargin = 0;
+
+    int status = 0;
+    for (std::size_t f = 0; f < files.size(); f += 2) {
+        std::vector<uint8_t> expected;
+        if (!readLabels(files[f + 1], fast, expected)) {
+            std::cerr << files[f + 1] << ": expected " << fast.rows << " lines of " << fast.cols
+                      << " letters of \"RGBY\"\n";
+            return 1;
+        }
+        std::cout << files[f] << "\n";
+        try {
+            const int wrong = report("full", classify(files[f], full, reps), expected, full)
+                            + report("fast", classify(files[f], fast, reps), expected, fast);
+            report("lattice", classify(files[f], lattice, reps), expected, lattice);
+            if (wrong) {
+                status = 1;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+    }
+    return status;
+}
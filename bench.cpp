@@ -0,0 +1,382 @@
+#include <stdint-gcc.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "board.hpp"
+#include "reference_boards.hpp"
+#include "search.hpp"
+#include "tablebase.hpp"
+
+// Microbenchmarks of the solver's hot paths and full single threaded solves
+// of the reference boards. Every run uses the same positions, so results
+// can be compared between commits:
+//   build/bench --reps 10 --json before.json
+
+typedef std::chrono::steady_clock Clock;
+
+// Keeps the compiler from dropping work whose result is never used.
+static volatile uint64_t sink;
+
+struct Result {
+    std::string name;
+    std::string unit;    // what one op is
+    uint64_t ops = 0;    // per repetition
+    std::vector<double> seconds;
+    std::string extra;   // JSON members describing the run, may be empty
+
+    double ns_per_op(double s) const { return s * 1e9 / ops; }
+
+    void summary(double& mean, double& stddev, double& min) const {
+        mean = 0;
+        min = 1e300;
+        for (double s : seconds) {
+            mean += ns_per_op(s);
+            min = std::min(min, ns_per_op(s));
+        }
+        mean /= seconds.size();
+        stddev = 0;
+        for (double s : seconds) {
+            stddev += (ns_per_op(s) - mean) * (ns_per_op(s) - mean);
+        }
+        stddev = seconds.size() > 1 ? std::sqrt(stddev / (seconds.size() - 1)) : 0;
+    }
+};
+
+// Positions met on random playouts of the reference boards, from the full
+// board down to a handful of groups, each with one random legal move.
+struct Sample {
+    PackedBoard board;
+    Move move;
+};
+
+static std::vector<Sample> sample_positions(int playouts, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<Sample> samples;
+    Groups moves;
+    for (int i = 0; i < playouts; i++) {
+        for (const ReferenceBoard& ref : reference_boards()) {
+            PackedBoard board(ref.board);
+            for (board.groups(moves); moves.size() > 1; board.groups(moves)) {
+                const Move mv = moves[rng() % moves.size()];
+                samples.push_back({board, mv});
+                board.remove(mv);
+            }
+        }
+    }
+    return samples;
+}
+
+static Board unpack(const PackedBoard& packed) {
+    Board board{};
+    for (int x = 0; x < HSIZE; x++) {
+        for (int y = 0; y < VSIZE; y++) {
+            board[x][y] = packed.at(Coord(x, y));
+        }
+    }
+    return board;
+}
+
+// Times rounds passes of op over every sample, reps times.
+template<class F>
+static Result micro(const std::string& name, const std::string& unit, int reps,
+                    int rounds, std::size_t count, F op) {
+    Result r;
+    r.name = name;
+    r.unit = unit;
+    for (int rep = 0; rep < reps; rep++) {
+        uint64_t ops = 0;
+        const auto t0 = Clock::now();
+        for (int i = 0; i < rounds; i++) {
+            for (std::size_t j = 0; j < count; j++) {
+                ops += op(j);
+            }
+        }
+        const std::chrono::duration<double> secs = Clock::now() - t0;
+        r.seconds.push_back(secs.count());
+        r.ops = ops;
+    }
+    return r;
+}
+
+// A single threaded greedy solve from an empty table, as main runs it.
+static Result solve(const ReferenceBoard& ref, int reps, int depth, std::size_t width, std::size_t tt_mb,
+                    const Tablebase* tablebase) {
+    Result r;
+    r.name = std::string("solve/") + ref.name;
+    r.unit = "state";
+    const Game root{PackedBoard(ref.board)};
+    for (int rep = 0; rep < reps; rep++) {
+        TranspositionTable tt(tt_mb);
+        std::atomic<bool> done{false};
+        Search search(tt, done);
+        search.tablebase = tablebase;
+        const auto t0 = Clock::now();
+        search.search(root, depth, width);
+        const std::chrono::duration<double> secs = Clock::now() - t0;
+        r.seconds.push_back(secs.count());
+        r.ops = search.states;
+        const std::size_t moves = search.found ? complete(root.board, search.solution, tablebase).size() : 0;
+        r.extra = "\"depth\": " + std::to_string(depth) + ", \"width\": " + std::to_string(width)
+                + ", \"solved\": " + (search.found ? "true" : "false")
+                + ", \"moves\": " + std::to_string(moves);
+    }
+    return r;
+}
+
+// A beam search solve of width beam on one worker.
+static Result beam_solve(const ReferenceBoard& ref, int reps, std::size_t beam) {
+    Result r;
+    r.name = std::string("beam/") + ref.name;
+    r.unit = "state";
+    const Game root{PackedBoard(ref.board)};
+    WorkStealingPool pool(1);
+    for (int rep = 0; rep < reps; rep++) {
+        BeamSearch search(pool, beam);
+        const auto t0 = Clock::now();
+        const Path solution = search.search(root);
+        const std::chrono::duration<double> secs = Clock::now() - t0;
+        r.seconds.push_back(secs.count());
+        r.ops = search.states();
+        r.extra = "\"beam\": " + std::to_string(beam) + ", \"moves\": " + std::to_string(solution.size());
+    }
+    return r;
+}
+
+// A rollout search solve of the given level on one worker, stopped after
+// max_states states so that it takes the same moves every repetition.
+static Result nrpa_solve(const ReferenceBoard& ref, int reps, int level, uint64_t max_states) {
+    Result r;
+    r.name = std::string("nrpa/") + ref.name;
+    r.unit = "state";
+    const PackedBoard board(ref.board);
+    WorkStealingPool pool(1);
+    for (int rep = 0; rep < reps; rep++) {
+        Anytime anytime(board, 0, max_states);
+        RolloutSearch search(pool, anytime, level);
+        const auto t0 = Clock::now();
+        const Path solution = search.run(Game(board));
+        const std::chrono::duration<double> secs = Clock::now() - t0;
+        r.seconds.push_back(secs.count());
+        r.ops = search.states();
+        r.extra = "\"level\": " + std::to_string(level) + ", \"moves\": " + std::to_string(solution.size());
+    }
+    return r;
+}
+
+static void print_table(std::ostream& os, const std::vector<Result>& results) {
+    os << "benchmark               ops/rep   ns/op mean  stddev      min     ops/s\n";
+    for (const Result& r : results) {
+        double mean, stddev, min;
+        r.summary(mean, stddev, min);
+        char line[160];
+        snprintf(line, sizeof(line), "%-20s %10llu %10.2f %7.2f %8.2f %9.3g  (%s)\n",
+                 r.name.c_str(), (unsigned long long)r.ops, mean, stddev, min, 1e9 / mean, r.unit.c_str());
+        os << line;
+    }
+}
+
+static void print_json(std::ostream& os, const std::vector<Result>& results, int reps, uint64_t seed) {
+    os << "{\n  \"reps\": " << reps << ",\n  \"seed\": " << seed << ",\n  \"results\": [\n";
+    for (std::size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        double mean, stddev, min;
+        r.summary(mean, stddev, min);
+        os << "    {\"name\": \"" << r.name << "\", \"unit\": \"" << r.unit << "\", \"ops\": " << r.ops
+           << ", \"ns_per_op\": {\"mean\": " << mean << ", \"stddev\": " << stddev << ", \"min\": " << min
+           << "}, \"ops_per_s\": " << 1e9 / mean;
+        if (!r.extra.empty()) {
+            os << ", " << r.extra;
+        }
+        os << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    os << "  ]\n}\n";
+}
+
+int main(int argc, char** argv) {
+    int reps = 5;
+    int depth = 10;
+    std::size_t width = 4;
+    std::size_t beam = 256;
+    int nrpa = 3;
+    uint64_t nrpa_states = 2000000;
+    std::size_t tt_mb = 64;
+    uint64_t seed = 1;
+    std::string json;
+    std::string filter;
+    std::string tablebase_file;
+    // Numbers that do not parse end up in the catch below.
+    bool bad = false;
+    int i = 1;
+    try {
+        for (; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--reps" && i + 1 < argc) {
+                reps = std::max(1, std::stoi(argv[++i]));
+            } else if (arg == "--depth" && i + 1 < argc) {
+                depth = std::stoi(argv[++i]);
+            } else if (arg == "--width" && i + 1 < argc) {
+                width = std::stoul(argv[++i]);
+            } else if (arg == "--beam" && i + 1 < argc) {
+                beam = std::stoul(argv[++i]);
+            } else if (arg == "--nrpa" && i + 1 < argc) {
+                nrpa = std::max(1, std::stoi(argv[++i]));
+            } else if (arg == "--nrpa-states" && i + 1 < argc) {
+                nrpa_states = std::stoull(argv[++i]);
+            } else if (arg == "--tt-mb" && i + 1 < argc) {
+                tt_mb = std::stoul(argv[++i]);
+            } else if (arg == "--seed" && i + 1 < argc) {
+                seed = std::stoull(argv[++i]);
+            } else if (arg == "--json" && i + 1 < argc) {
+                json = argv[++i];
+            } else if (arg == "--filter" && i + 1 < argc) {
+                filter = argv[++i];
+            } else if (arg == "--tablebase" && i + 1 < argc) {
+                tablebase_file = argv[++i];
+            } else {
+                bad = true;
+                break;
+            }
+        }
+    } catch (const std::exception&) {
+        std::cerr << "Bad value for " << argv[i - 1] << ": " << argv[i] << "\n";
+        bad = true;
+    }
+    if (bad || !SearchPolicy::allowed(SearchPolicy::DEPTH, depth)
+        || !SearchPolicy::allowed(SearchPolicy::WIDTH, double(width))) {
+        std::cerr << "Usage: " << argv[0] << " [--reps N] [--depth N] [--width N] [--beam K] [--nrpa L] [--nrpa-states N]"
+                  << " [--tt-mb N]"
+                  << " [--seed N] [--filter SUBSTRING] [--tablebase FILE] [--json FILE|-]\n";
+        return 1;
+    }
+    if (tt_mb < 1 || tt_mb > TranspositionTable::MAX_MEGABYTES) {
+        std::cerr << "--tt-mb must be between 1 and " << TranspositionTable::MAX_MEGABYTES << "\n";
+        return 1;
+    }
+    std::unique_ptr<Tablebase> tablebase;
+    if (!tablebase_file.empty()) {
+        try {
+            tablebase.reset(new Tablebase(tablebase_file, HSIZE, VSIZE));
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+    }
+    auto wanted = [&filter](const std::string& name) {
+        return filter.empty() || name.find(filter) != std::string::npos;
+    };
+
+    const std::vector<Sample> samples = sample_positions(50, seed);
+    std::vector<Board> holed;
+    std::vector<Game> games;
+    for (const Sample& s : samples) {
+        PackedBoard cleared = s.board;
+        for (int c = 0; c < PackedBoard::COLORS; c++) {
+            cleared.planes[c] = s.board.planes[c] & ~s.move;
+        }
+        holed.push_back(unpack(cleared));
+        games.emplace_back(s.board);
+    }
+    const std::size_t n = samples.size();
+    std::vector<Result> results;
+
+    if (wanted("vertical_fall")) {
+        results.push_back(micro("vertical_fall", "board", reps, 20, n, [&](std::size_t i) {
+            Board b = holed[i];
+            b.fall();
+            sink = sink + b[0][VSIZE - 1];
+            return 1;
+        }));
+    }
+    if (wanted("packed_remove")) {
+        results.push_back(micro("packed_remove", "move", reps, 200, n, [&](std::size_t i) {
+            PackedBoard b = samples[i].board;
+            b.remove(samples[i].move);
+            sink = sink + b.planes[0];
+            return 1;
+        }));
+    }
+    if (wanted("calculate_moves")) {
+        results.push_back(micro("calculate_moves", "board", reps, 20, n, [&](std::size_t i) {
+            sink = sink + games[i].calculate_moves();
+            return 1;
+        }));
+    }
+    if (wanted("groups")) {
+        Groups moves;
+        results.push_back(micro("groups", "board", reps, 20, n, [&](std::size_t i) {
+            samples[i].board.groups(moves);
+            sink = sink + moves.size();
+            return 1;
+        }));
+    }
+    if (wanted("children")) {
+        // What Search does per expanded node: every child, scored.
+        NodeArena arena;
+        results.push_back(micro("children", "state", reps, 5, n, [&](std::size_t i) {
+            Groups& moves = arena.moves_at(0);
+            Game* children = arena.games_at(0);
+            games[i].board.groups(moves);
+            for (std::size_t j = 0; j < moves.size(); j++) {
+                children[j] = Game(games[i], moves[j]);
+                children[j].score = children[j].calculate_moves();
+            }
+            sort_games(children, moves.size());
+            sink = sink + children[0].hash;
+            return moves.size();
+        }));
+    }
+    if (wanted("children_incremental")) {
+        // The same with the children's groups counted from the parent's,
+        // as Search does now.
+        NodeArena arena;
+        results.push_back(micro("children_incremental", "state", reps, 5, n, [&](std::size_t i) {
+            Groups& moves = arena.moves_at(0);
+            Game* children = arena.games_at(0);
+            games[i].board.groups(moves);
+            for (std::size_t j = 0; j < moves.size(); j++) {
+                children[j] = Game(games[i], moves[j]);
+                children[j].score = children[j].board.count_groups_after(moves, moves[j]);
+            }
+            sort_games(children, moves.size());
+            sink = sink + children[0].hash;
+            return moves.size();
+        }));
+    }
+    for (const ReferenceBoard& ref : reference_boards()) {
+        if (wanted(std::string("solve/") + ref.name)) {
+            results.push_back(solve(ref, reps, depth, width, tt_mb, tablebase.get()));
+        }
+    }
+    for (const ReferenceBoard& ref : reference_boards()) {
+        if (wanted(std::string("beam/") + ref.name)) {
+            results.push_back(beam_solve(ref, reps, beam));
+        }
+    }
+    for (const ReferenceBoard& ref : reference_boards()) {
+        if (wanted(std::string("nrpa/") + ref.name)) {
+            results.push_back(nrpa_solve(ref, reps, nrpa, nrpa_states));
+        }
+    }
+
+    std::cout << n << " sampled positions, " << reps << " repetitions, solves at depth "
+              << depth << " width " << width << ", beam " << beam << ", nrpa level " << nrpa << " for "
+              << nrpa_states << " states\n";
+    print_table(std::cout, results);
+    if (json == "-") {
+        print_json(std::cout, results, reps, seed);
+    } else if (!json.empty()) {
+        std::ofstream out(json);
+        if (!out) {
+            std::cerr << "Failed to open " << json << "\n";
+            return 1;
+        }
+        print_json(out, results, reps, seed);
+    }
+    return 0;
+}
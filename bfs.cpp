@@ -0,0 +1,522 @@
+#include <stdint-gcc.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <queue>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <unistd.h>
+#include "board.hpp"
+#include "reference_boards.hpp"
+#include "search.hpp"
+
+// Exhaustive breadth first search of every position reachable from one
+// board, for counting the distinct positions at each depth and proving
+// the optimum:
+//   build/bfs --dir work --memory-mb 4096 --reference 21-8
+// Each layer is kept on disk as a sorted file of positions. The children
+// of a layer are sorted in memory-sized runs, and the runs are merged into
+// the next layer, dropping every position already in an earlier layer.
+// A finished layer is renamed into place in one step, so after a crash the
+// same command resumes from the last complete layer.
+
+namespace fs = std::filesystem;
+
+// A position on disk: its squares and two bits of color for each.
+struct Record {
+    uint64_t occupied;
+    uint64_t low;
+    uint64_t high;
+
+    bool operator<(const Record& rh) const {
+        return std::tie(occupied, low, high) < std::tie(rh.occupied, rh.low, rh.high);
+    }
+    bool operator==(const Record& rh) const {
+        return occupied == rh.occupied && low == rh.low && high == rh.high;
+    }
+};
+
+template<int W, int H>
+static Record encode(const BasicPackedBoard<W, H>& board) {
+    return Record{board.occupied(), board.planes[1] | board.planes[3], board.planes[2] | board.planes[3]};
+}
+
+template<int W, int H>
+static BasicPackedBoard<W, H> decode(const Record& r) {
+    BasicPackedBoard<W, H> board;
+    board.planes[0] = r.occupied & ~r.low & ~r.high;
+    board.planes[1] = r.low & ~r.high;
+    board.planes[2] = r.high & ~r.low;
+    board.planes[3] = r.low & r.high;
+    return board;
+}
+
+// Buffered sequential reading of a file of records.
+class RecordReader {
+public:
+    RecordReader(const fs::path& path, std::size_t buffer_records) : buf(std::max<std::size_t>(1, buffer_records)) {
+        file = std::fopen(path.c_str(), "rb");
+        if (!file) {
+            throw std::runtime_error("Failed to open " + path.string());
+        }
+        fill();
+    }
+    ~RecordReader() {
+        std::fclose(file);
+    }
+    RecordReader(const RecordReader&) = delete;
+    RecordReader& operator=(const RecordReader&) = delete;
+
+    bool done() const { return pos == len; }
+    const Record& peek() const { return buf[pos]; }
+    void next() {
+        if (++pos == len) {
+            fill();
+        }
+    }
+
+private:
+    std::FILE* file;
+    std::vector<Record> buf;
+    std::size_t pos = 0;
+    std::size_t len = 0;
+
+    void fill() {
+        pos = 0;
+        len = std::fread(buf.data(), sizeof(Record), buf.size(), file);
+    }
+};
+
+// Writes records to path through a temporary file, which only replaces
+// path once everything is on disk.
+class RecordWriter {
+public:
+    explicit RecordWriter(const fs::path& target) : path(target), tmp(target.string() + ".tmp") {
+        file = std::fopen(tmp.c_str(), "wb");
+        if (!file) {
+            throw std::runtime_error("Failed to create " + tmp.string());
+        }
+        buf.reserve(1 << 16);
+    }
+    ~RecordWriter() {
+        if (file) {
+            std::fclose(file);
+        }
+    }
+    RecordWriter(const RecordWriter&) = delete;
+    RecordWriter& operator=(const RecordWriter&) = delete;
+
+    void push(const Record& r) {
+        buf.push_back(r);
+        if (buf.size() == buf.capacity()) {
+            flush();
+        }
+    }
+
+    void commit() {
+        flush();
+        if (std::fflush(file) != 0 || fsync(fileno(file)) != 0 || std::fclose(file) != 0) {
+            file = nullptr;
+            throw std::runtime_error("Failed to write " + tmp.string());
+        }
+        file = nullptr;
+        fs::rename(tmp, path);
+    }
+
+private:
+    fs::path path;
+    fs::path tmp;
+    std::FILE* file;
+    std::vector<Record> buf;
+
+    void flush() {
+        if (std::fwrite(buf.data(), sizeof(Record), buf.size(), file) != buf.size()) {
+            throw std::runtime_error("Failed to write " + tmp.string());
+        }
+        buf.clear();
+    }
+};
+
+template<int W, int H>
+class ExternalBfs {
+public:
+    typedef BasicPackedBoard<W, H> PackedBoard;
+    typedef BasicPath<W, H> Path;
+    typedef std::chrono::steady_clock Clock;
+
+    ExternalBfs(const fs::path& directory, std::size_t memory_mb, const PackedBoard& start)
+        : dir(directory), memory(std::max<std::size_t>(1, memory_mb) << 20), root(start),
+          mirrored(start.symmetric()) {}
+
+    // Searches from root until a layer is empty, or until the first layer
+    // with the cleared board if stop_at_optimum. Returns the optimum, -1 if
+    // the search stopped before reaching it.
+    int run(bool stop_at_optimum) {
+        start_time = Clock::now();
+        int depth = resume();
+        int optimum = -1;
+        Count total;
+        for (int d = 0; d <= depth; d++) {
+            const Count c = count(d);
+            total += c;
+            if (d > 0) {
+                report(d, c, total);
+            }
+            if (optimum < 0 && has_cleared(d)) {
+                optimum = d;
+            }
+        }
+        while (!(stop_at_optimum && optimum >= 0)) {
+            const std::vector<fs::path> runs = expand(depth);
+            const Count c = merge(runs, depth + 1);
+            if (c.stored == 0) {
+                fs::remove(layer(depth + 1));
+                break;
+            }
+            depth++;
+            total += c;
+            report(depth, c, total);
+            if (optimum < 0 && has_cleared(depth)) {
+                optimum = depth;
+            }
+        }
+        std::cout << total.positions << " positions in " << depth + 1 << " layers" << std::endl;
+        if (optimum >= 0) {
+            const Path line = solution(optimum);
+            std::cout << "Optimum is " << optimum << " moves: " << line;
+        }
+        return optimum;
+    }
+
+private:
+    // Positions of a layer, and the records stored for them.
+    struct Count {
+        uint64_t stored = 0;
+        uint64_t positions = 0;
+
+        void add(const Record& r, bool mirrored) {
+            stored++;
+            positions += mirrored && !decode<W, H>(r).symmetric() ? 2 : 1;
+        }
+        Count& operator+=(const Count& rh) {
+            stored += rh.stored;
+            positions += rh.positions;
+            return *this;
+        }
+    };
+
+    const fs::path dir;
+    const std::size_t memory; // bytes of records held at once
+    const PackedBoard root;
+    // From a symmetric root every position is reached as early as its
+    // mirror image, so only the canonical one of the two is stored.
+    const bool mirrored;
+    Clock::time_point start_time;
+
+    Record key(const PackedBoard& board) const {
+        return encode(mirrored ? board.canonical() : board);
+    }
+
+    fs::path layer(int depth) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "layer-%03d.bin", depth);
+        return dir / name;
+    }
+
+    fs::path run_path(int depth, std::size_t index) const {
+        char name[40];
+        std::snprintf(name, sizeof(name), "layer-%03d.run-%04zu", depth, index);
+        return dir / name;
+    }
+
+    double elapsed() const {
+        return std::chrono::duration<double>(Clock::now() - start_time).count();
+    }
+
+    Count count(int depth) const {
+        Count c;
+        for (RecordReader in(layer(depth), 1 << 16); !in.done(); in.next()) {
+            c.add(in.peek(), mirrored);
+        }
+        return c;
+    }
+
+    void report(int depth, const Count& c, const Count& total) const {
+        std::cout << "depth " << depth << ": " << c.positions << " positions";
+        if (mirrored) {
+            std::cout << " (" << c.stored << " up to mirror image)";
+        }
+        std::cout << ", " << total.positions << " in total, " << elapsed() << " s" << std::endl;
+    }
+
+    // The empty board is the least record, so it can only be first.
+    bool has_cleared(int depth) const {
+        RecordReader in(layer(depth), 1);
+        return !in.done() && in.peek().occupied == 0;
+    }
+
+    // Returns the deepest complete layer, after checking that dir holds
+    // this board's search (or starting one) and removing what a crash left
+    // of the layer after it, and the runs of the deepest one if it came
+    // after that layer was renamed into place but before they were deleted.
+    int resume() {
+        fs::create_directories(dir);
+        const fs::path board_file = dir / "board.txt";
+        std::ostringstream text;
+        text << W << "x" << H << "\n" << root;
+        if (fs::exists(board_file)) {
+            std::ifstream in(board_file);
+            std::stringstream saved;
+            saved << in.rdbuf();
+            if (saved.str() != text.str()) {
+                throw std::runtime_error(dir.string() + " holds the search of another board");
+            }
+        } else {
+            std::ofstream(board_file) << text.str();
+        }
+        int depth = 0;
+        if (!fs::exists(layer(0))) {
+            RecordWriter out(layer(0));
+            out.push(key(root));
+            out.commit();
+        }
+        while (fs::exists(layer(depth + 1))) {
+            depth++;
+        }
+        char next[32], runs[32];
+        std::snprintf(next, sizeof(next), "layer-%03d.", depth + 1);
+        std::snprintf(runs, sizeof(runs), "layer-%03d.run-", depth);
+        std::vector<fs::path> leftovers;
+        for (const auto& entry : fs::directory_iterator(dir)) {
+            const std::string name = entry.path().filename().string();
+            if (name.rfind(next, 0) == 0 || name.rfind(runs, 0) == 0) {
+                leftovers.push_back(entry.path());
+            }
+        }
+        for (const fs::path& path : leftovers) {
+            fs::remove(path);
+        }
+        return depth;
+    }
+
+    // Writes the children of layer depth as sorted, deduplicated runs of
+    // at most memory bytes each.
+    std::vector<fs::path> expand(int depth) {
+        const uint64_t parents = fs::file_size(layer(depth)) / sizeof(Record);
+        const std::size_t capacity = std::max<std::size_t>(1024, memory / sizeof(Record));
+        std::vector<Record> children;
+        children.reserve(capacity);
+        std::vector<fs::path> runs;
+        auto write_run = [&](uint64_t done) {
+            std::sort(children.begin(), children.end());
+            children.erase(std::unique(children.begin(), children.end()), children.end());
+            runs.push_back(run_path(depth + 1, runs.size()));
+            RecordWriter out(runs.back());
+            for (const Record& r : children) {
+                out.push(r);
+            }
+            out.commit();
+            children.clear();
+            std::cout << "  depth " << depth + 1 << ": run " << runs.size() << " written, "
+                      << done << "/" << parents << " parents expanded, " << elapsed() << " s" << std::endl;
+        };
+        RecordReader in(layer(depth), 1 << 16);
+        Groups moves;
+        for (uint64_t done = 0; !in.done(); in.next(), done++) {
+            const PackedBoard board = decode<W, H>(in.peek());
+            board.groups(moves);
+            if (children.size() + moves.size() > capacity) {
+                write_run(done);
+            }
+            for (const Move mv : moves) {
+                PackedBoard child = board;
+                child.remove(mv);
+                children.push_back(key(child));
+            }
+        }
+        if (!children.empty()) {
+            write_run(parents);
+        }
+        return runs;
+    }
+
+    // Merges runs into layer depth, leaving out positions already in a
+    // shallower layer, and deletes the runs.
+    Count merge(const std::vector<fs::path>& runs, int depth) {
+        const std::size_t buffer = std::max<std::size_t>(4096, memory / sizeof(Record) / (runs.size() + depth + 1));
+        std::vector<std::unique_ptr<RecordReader>> inputs;
+        for (const fs::path& run : runs) {
+            inputs.emplace_back(new RecordReader(run, buffer));
+        }
+        std::vector<std::unique_ptr<RecordReader>> seen;
+        for (int d = 0; d < depth; d++) {
+            seen.emplace_back(new RecordReader(layer(d), buffer));
+        }
+        typedef std::pair<Record, std::size_t> Head;
+        auto later = [](const Head& a, const Head& b) { return b.first < a.first; };
+        std::priority_queue<Head, std::vector<Head>, decltype(later)> heads(later);
+        for (std::size_t i = 0; i < inputs.size(); i++) {
+            if (!inputs[i]->done()) {
+                heads.push(Head(inputs[i]->peek(), i));
+            }
+        }
+        RecordWriter out(layer(depth));
+        Count c;
+        bool first = true;
+        Record last = {};
+        while (!heads.empty()) {
+            const Head head = heads.top();
+            heads.pop();
+            RecordReader& from = *inputs[head.second];
+            from.next();
+            if (!from.done()) {
+                heads.push(Head(from.peek(), head.second));
+            }
+            if (!first && head.first == last) {
+                continue;
+            }
+            first = false;
+            last = head.first;
+            bool old = false;
+            for (auto& s : seen) {
+                while (!s->done() && s->peek() < last) {
+                    s->next();
+                }
+                old = old || (!s->done() && s->peek() == last);
+            }
+            if (!old) {
+                out.push(last);
+                c.add(last, mirrored);
+            }
+        }
+        out.commit();
+        inputs.clear();
+        for (const fs::path& run : runs) {
+            fs::remove(run);
+        }
+        return c;
+    }
+
+    // An optimal line from root: walks back from the cleared board through
+    // the layers for a parent of every position, then replays the chain
+    // from root, choosing at each step the move whose result is, up to
+    // mirror image, the next position of the chain.
+    Path solution(int optimum) const {
+        std::vector<Record> chain(optimum + 1);
+        chain[optimum] = Record{0, 0, 0};
+        Groups moves;
+        for (int d = optimum - 1; d >= 0; d--) {
+            bool found = false;
+            for (RecordReader in(layer(d), 1 << 16); !in.done() && !found; in.next()) {
+                const PackedBoard board = decode<W, H>(in.peek());
+                board.groups(moves);
+                for (const Move mv : moves) {
+                    PackedBoard child = board;
+                    child.remove(mv);
+                    if (key(child) == chain[d + 1]) {
+                        chain[d] = in.peek();
+                        found = true;
+                        break;
+                    }
+                }
+            }
+        }
+        Path line;
+        PackedBoard board = root;
+        for (int d = 1; d <= optimum; d++) {
+            board.groups(moves);
+            for (const Move mv : moves) {
+                PackedBoard child = board;
+                child.remove(mv);
+                if (key(child) == chain[d]) {
+                    line.push_back(PackedBoard::origin(mv));
+                    board = child;
+                    break;
+                }
+            }
+        }
+        return line;
+    }
+};
+
+int main(int argc, char** argv) {
+    int size_w = HSIZE;
+    int size_h = VSIZE;
+    std::size_t memory_mb = 1024;
+    bool stop_at_optimum = false;
+    std::string dir;
+    std::string reference;
+    std::string board_text;
+    // Numbers that do not parse leave dir empty, for the usage below.
+    int i = 1;
+    try {
+        for (; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--size" && i + 1 < argc) {
+                if (std::sscanf(argv[++i], "%dx%d", &size_w, &size_h) != 2) {
+                    size_w = size_h = 0;
+                }
+            } else if (arg == "--memory-mb" && i + 1 < argc) {
+                memory_mb = std::stoul(argv[++i]);
+            } else if (arg == "--dir" && i + 1 < argc) {
+                dir = argv[++i];
+            } else if (arg == "--reference" && i + 1 < argc) {
+                reference = argv[++i];
+            } else if (arg == "--stop-at-optimum") {
+                stop_at_optimum = true;
+            } else {
+                board_text = arg;
+            }
+        }
+    } catch (const std::exception&) {
+        std::cerr << "Bad value for " << argv[i - 1] << ": " << argv[i] << "\n";
+        dir.clear();
+    }
+    // --memory-mb stops at 1 TB, so its size in bytes cannot overflow.
+    if (dir.empty() || reference.empty() == board_text.empty() || memory_mb > (std::size_t(1) << 20)) {
+        std::cerr << "Usage: " << argv[0] << " --dir DIR [--memory-mb N] [--stop-at-optimum] [--size WxH] <board>\n"
+                  << "       " << argv[0] << " --dir DIR [--memory-mb N] [--stop-at-optimum] --reference NAME\n"
+                  << "The board is one line of the batch format.\n";
+        return 1;
+    }
+    if (!reference.empty()) {
+        for (const ReferenceBoard& ref : reference_boards()) {
+            if (reference == ref.name) {
+                std::cout << ref.note << "\n";
+                try {
+                    ExternalBfs<HSIZE, VSIZE>(dir, memory_mb, PackedBoard(ref.board)).run(stop_at_optimum);
+                } catch (const std::exception& e) {
+                    std::cerr << e.what() << "\n";
+                    return 1;
+                }
+                return 0;
+            }
+        }
+        std::cerr << "No reference board " << reference << "\n";
+        return 1;
+    }
+    int status = 1;
+    const bool known = with_board_size(size_w, size_h, [&](auto size) {
+        BasicPackedBoard<size.width, size.height> board;
+        if (!parse_board(board_text, board)) {
+            std::cerr << "Expected " << size.width * size.height << " fallen squares of \"-RGBY\"\n";
+            return;
+        }
+        try {
+            ExternalBfs<size.width, size.height>(dir, memory_mb, board).run(stop_at_optimum);
+            status = 0;
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+        }
+    });
+    if (!known) {
+        std::cerr << "No solver for " << size_w << "x" << size_h << " boards, sizes are " << BOARD_SIZES << "\n";
+    }
+    return status;
+}
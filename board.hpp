@@ -0,0 +1,543 @@
+#pragma once
+#include <stdint-gcc.h>
+#include <array>
+#include <cctype>
+#include <iostream>
+#include <string>
+#include <vector>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+#include "board_annotate.hpp"
+
+static constexpr char toLetter(uint8_t sq) {
+    return "-RGBY"[sq];
+}
+
+typedef uint8_t Square;
+typedef std::pair<int,int> Coord;
+
+inline std::ostream& operator<<(std::ostream& os, const Coord& co) {
+    os << "(" << co.first << "," << co.second << ")";
+    return os;
+}
+
+template<int H>
+class BasicVertical : public std::array<Square, H> {
+public:
+    BasicVertical() = default;
+    BasicVertical(const std::array<Square, H>& ref) : std::array<Square, H>(ref) {}
+    void fall(){
+        for(auto it = this->rbegin(); it != this->rend();) {
+            if(*it == 0){
+                bool all_zero = true;
+                for(auto x = it; x != this->rend(); x++){
+                    if(*x){
+                        all_zero = false;
+                        break;
+                    }
+                }
+                if(all_zero){
+                    break;
+                }
+                for(auto it2 = it; it2 != (this->rend() - 1); it2++) {
+                    *it2 = *(it2 + 1);
+                }
+                *this->begin() = 0;
+            } else {
+                it++;
+            }
+        }
+    }
+};
+
+template<int W, int H>
+class BasicBoard : public std::array<BasicVertical<H>, W>{
+public:
+    BasicBoard() = default;
+    BasicBoard(const std::array<BasicVertical<H>, W>& ref) : std::array<BasicVertical<H>, W>(ref) {}
+    void fall() {
+        for(auto& elem : *this){
+            elem.fall();
+        }
+    }
+    Square at(const Coord co) {
+#if 0 // Bounds checking
+        return this->std::array<BasicVertical<H>, W>::at(co.first).at(co.second);
+#else // YOLO
+        return (*this)[co.first][co.second];
+#endif
+    }
+};
+
+template<int W, int H>
+std::ostream& operator<<(std::ostream& os, const BasicBoard<W, H>& arr) {
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            os << toLetter(arr[x][y]) << ' ';
+        }
+        os << '\n';
+    }
+    return os;
+}
+
+typedef BasicVertical<VSIZE> Vertical;
+typedef BasicBoard<HSIZE, VSIZE> Board;
+
+// Squares a packed board can hold: one bit each, below bit 63 so that
+// masks like (1 << squares) - 1 stay defined.
+static constexpr int MAX_SQUARES = 63;
+
+typedef uint64_t Move; // mask of the squares in the group to remove
+
+static constexpr uint64_t splitmix64(uint64_t& state) {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// Zobrist keys, one per (color, square bit)
+static constexpr std::array<std::array<uint64_t, 64>, 4> zobrist_keys() {
+    std::array<std::array<uint64_t, 64>, 4> keys = {};
+    uint64_t state = 0x5eed;
+    for (auto& color : keys) {
+        for (auto& key : color) {
+            key = splitmix64(state);
+        }
+    }
+    return keys;
+}
+static constexpr auto ZOBRIST = zobrist_keys();
+
+// ZOBRIST with the squares of a W x H board reflected left to right, so
+// hashing a board with these keys gives the hash of its mirror image.
+template<int W, int H>
+static constexpr std::array<std::array<uint64_t, 64>, 4> mirror_zobrist_keys() {
+    std::array<std::array<uint64_t, 64>, 4> keys = {};
+    for (int c = 0; c < 4; c++) {
+        for (int b = 0; b < W * H; b++) {
+            keys[c][b] = ZOBRIST[c][(W - 1 - b / H) * H + b % H];
+        }
+    }
+    return keys;
+}
+template<int W, int H>
+static constexpr auto MIRROR_ZOBRIST = mirror_zobrist_keys<W, H>();
+
+// Fixed capacity list of groups, in the order their first square is met
+// when scanning rows top to bottom, left to right.
+class Groups {
+public:
+    std::array<Move, MAX_SQUARES> masks;
+    int count = 0;
+
+    std::size_t size() const { return count; }
+    const Move& operator[](std::size_t i) const { return masks[i]; }
+    const Move* begin() const { return masks.data(); }
+    const Move* end() const { return masks.data() + count; }
+    void push_back(Move mv) { masks[count++] = mv; }
+    void clear() { count = 0; }
+};
+
+// Board packed into one bit plane per color. Column x owns bits
+// [x*H, (x+1)*H), with bit 0 of a column being the bottom square, so
+// gravity is "compact every column towards its low bits". Every mask is a
+// compile time constant of the board size, and so are all loop bounds.
+template<int W, int H>
+class BasicPackedBoard {
+public:
+    static_assert(W > 0 && H > 0 && W * H <= MAX_SQUARES, "board does not fit in 63 bits");
+    static constexpr int WIDTH = W;
+    static constexpr int HEIGHT = H;
+    static constexpr int SQUARES = W * H;
+    static constexpr int COLORS = 4;
+    static constexpr uint64_t COLUMN = (1ull << H) - 1;
+    static constexpr uint64_t FULL = (1ull << (W * H)) - 1;
+    static constexpr uint64_t BOTTOM = FULL / COLUMN;
+    static constexpr uint64_t TOP = BOTTOM << (H - 1);
+
+    std::array<uint64_t, COLORS> planes = {0};
+
+    BasicPackedBoard() = default;
+    BasicPackedBoard(const BasicBoard<W, H>& brd) {
+        for (int x = 0; x < W; x++) {
+            for (int y = 0; y < H; y++) {
+                if (brd[x][y]) {
+                    planes[brd[x][y] - 1] |= cell(x, y);
+                }
+            }
+        }
+    }
+
+    static constexpr int bit(int x, int y) {
+        return x * H + (H - 1 - y);
+    }
+    static constexpr uint64_t cell(int x, int y) {
+        return 1ull << bit(x, y);
+    }
+    static constexpr uint64_t cell(const Coord co) {
+        return cell(co.first, co.second);
+    }
+    static constexpr uint64_t column(int x) {
+        return COLUMN << (x * H);
+    }
+    static constexpr uint64_t row(int y) {
+        return BOTTOM << (H - 1 - y);
+    }
+    static Coord coord(int b) {
+        return Coord(b / H, H - 1 - b % H);
+    }
+
+    // First square of a group in row scan order, i.e. the top row's leftmost.
+    // One byte identifies a move: the group is the one holding this square.
+    static uint8_t origin(Move mv) {
+        for (int y = 0; y < H; y++) {
+            if (mv & row(y)) {
+                return __builtin_ctzll(mv & row(y));
+            }
+        }
+        return 0;
+    }
+
+    // Grows seed into its 4-connected component within plane.
+    static uint64_t flood(uint64_t seed, uint64_t plane) {
+        uint64_t grp = seed, prev;
+        do {
+            prev = grp;
+            grp |= ((grp << 1) & ~BOTTOM) | ((grp >> 1) & ~TOP)
+                 | (grp << H) | (grp >> H);
+            grp &= plane;
+        } while (grp != prev);
+        return grp;
+    }
+
+    // All columns that have at least one square in mask.
+    static uint64_t columns(uint64_t mask) {
+        uint64_t cols = 0;
+        while (mask) {
+            const uint64_t col = column(__builtin_ctzll(mask) / H);
+            cols |= col;
+            mask &= ~col;
+        }
+        return cols;
+    }
+
+    // Zobrist hash of the squares inside region. Hashes of disjoint regions
+    // combine with xor, so a move only rehashes the columns it touched.
+    uint64_t hash(uint64_t region = FULL) const {
+        uint64_t h = 0;
+        for (int c = 0; c < COLORS; c++) {
+            for (uint64_t sq = planes[c] & region; sq; sq &= sq - 1) {
+                h ^= ZOBRIST[c][__builtin_ctzll(sq)];
+            }
+        }
+        return h;
+    }
+
+    // hash() of the mirror image of the squares inside region. A position
+    // and its mirror have the same pair of hashes, swapped.
+    uint64_t mirror_hash(uint64_t region = FULL) const {
+        uint64_t h = 0;
+        for (int c = 0; c < COLORS; c++) {
+            for (uint64_t sq = planes[c] & region; sq; sq &= sq - 1) {
+                h ^= MIRROR_ZOBRIST<W, H>[c][__builtin_ctzll(sq)];
+            }
+        }
+        return h;
+    }
+
+    // Reflects mask left to right: column x becomes column W - 1 - x.
+    static uint64_t mirror(uint64_t mask) {
+        uint64_t m = 0;
+        for (int x = 0; x < W; x++) {
+            m |= ((mask >> (x * H)) & COLUMN) << ((W - 1 - x) * H);
+        }
+        return m;
+    }
+
+    BasicPackedBoard mirrored() const {
+        BasicPackedBoard m;
+        for (int c = 0; c < COLORS; c++) {
+            m.planes[c] = mirror(planes[c]);
+        }
+        return m;
+    }
+
+    // Gravity works per column and groups are 4-connected, so the rules
+    // are symmetric left to right: a board and its mirror image have the
+    // same solutions, mirrored. The canonical form is the lesser of the
+    // two, comparing the planes in order.
+    BasicPackedBoard canonical() const {
+        const BasicPackedBoard m = mirrored();
+        return m.planes < planes ? m : *this;
+    }
+
+    bool symmetric() const {
+        return *this == mirrored();
+    }
+
+    uint64_t occupied() const {
+        return planes[0] | planes[1] | planes[2] | planes[3];
+    }
+
+    // Bit x set if column x has a square in mask.
+    static unsigned column_set(uint64_t mask) {
+        unsigned set = 0;
+        for (int x = 0; x < W; x++) {
+            set |= ((mask & column(x)) != 0) << x;
+        }
+        return set;
+    }
+
+    // Admissible lower bound on the moves needed to clear the board.
+    // Squares never change column, so squares of one color in two columns
+    // with a column between them lacking that color can never join one
+    // group. Every maximal run of columns holding a color therefore needs
+    // a move of its own, and the bound is the number of such runs summed
+    // over the colors. It is never below the number of colors left.
+    int min_moves() const {
+        int runs = 0;
+        for (const uint64_t p : planes) {
+            const unsigned set = column_set(p);
+            runs += __builtin_popcount(set & ~(set << 1));
+        }
+        return runs;
+    }
+
+    Square at(const Coord co) const {
+        const uint64_t b = cell(co);
+        for (int c = 0; c < COLORS; c++) {
+            if (planes[c] & b) {
+                return c + 1;
+            }
+        }
+        return 0;
+    }
+
+    // Labels every same-color component, seeding from the unlabeled squares
+    // in row scan order, top to bottom and left to right.
+    template<class F>
+    void each_group(F f) const {
+        uint64_t left = occupied();
+        for (int y = 0; y < H && left; y++) {
+            uint64_t seeds = left & row(y);
+            while (seeds) {
+                const uint64_t seed = seeds & -seeds;
+                int c = 0;
+                while (!(planes[c] & seed)) {
+                    c++;
+                }
+                const uint64_t grp = flood(seed, planes[c]);
+                f(grp);
+                left &= ~grp;
+                seeds &= ~grp;
+            }
+        }
+    }
+
+    // Labels every component with a square in region, like each_group()
+    // but seeding only there. Components may reach outside region.
+    template<class F>
+    void label_region(uint64_t region, F f) const {
+        uint64_t seeds = occupied() & region;
+        while (seeds) {
+            const uint64_t seed = seeds & -seeds;
+            int c = 0;
+            while (!(planes[c] & seed)) {
+                c++;
+            }
+            const uint64_t grp = flood(seed, planes[c]);
+            f(grp);
+            seeds &= ~grp;
+        }
+    }
+
+    // The group holding square bit b, 0 if that square is empty.
+    Move group_at(int b) const {
+        for (const uint64_t p : planes) {
+            if (p >> b & 1) {
+                return flood(1ull << b, p);
+            }
+        }
+        return 0;
+    }
+
+    void groups(Groups& out) const {
+        out.clear();
+        each_group([&out](Move grp) { out.push_back(grp); });
+    }
+
+    int count_groups() const {
+        int count = 0;
+        each_group([&count](Move) { count++; });
+        return count;
+    }
+
+    // Position of square b in row scan order, which orders groups() by
+    // their origin squares.
+    static constexpr int scan_index(int b) {
+        return (H - 1 - b % H) * W + b / H;
+    }
+
+    // The squares a move can have changed the groups of: its columns, where
+    // squares fell, and the columns beside them, whose neighbours did.
+    static uint64_t affected(Move mv) {
+        const uint64_t cols = columns(mv);
+        return (cols | (cols << H) | (cols >> H)) & FULL;
+    }
+
+    // Incremental groups() for this board, reached from parent by removing
+    // move, where parent_groups are the parent's groups. Groups clear of
+    // affected(move) are unchanged and kept; only the rest are labeled
+    // again. The result is the same groups in the same order as groups().
+    void groups_after(const Groups& parent_groups, Move move, Groups& out) const {
+        const uint64_t region = affected(move);
+        Groups fresh;
+        label_region(region, [&fresh](Move grp) { fresh.push_back(grp); });
+        // Fresh groups were met in the order of their first square inside
+        // the region; order them by origin, then merge with the kept ones.
+        uint8_t keys[MAX_SQUARES];
+        for (int i = 0; i < fresh.count; i++) {
+            const Move grp = fresh.masks[i];
+            const uint8_t key = scan_index(origin(grp));
+            int j = i;
+            for (; j > 0 && keys[j - 1] > key; j--) {
+                fresh.masks[j] = fresh.masks[j - 1];
+                keys[j] = keys[j - 1];
+            }
+            fresh.masks[j] = grp;
+            keys[j] = key;
+        }
+        out.clear();
+        int f = 0;
+        for (const Move grp : parent_groups) {
+            if (grp & region) {
+                continue;
+            }
+            const uint8_t key = scan_index(origin(grp));
+            while (f < fresh.count && keys[f] < key) {
+                out.push_back(fresh.masks[f++]);
+            }
+            out.push_back(grp);
+        }
+        while (f < fresh.count) {
+            out.push_back(fresh.masks[f++]);
+        }
+    }
+
+    // Incremental count_groups(), as groups_after() but only counting.
+    int count_groups_after(const Groups& parent_groups, Move move) const {
+        const uint64_t region = affected(move);
+        int count = 0;
+        for (const Move grp : parent_groups) {
+            count += !(grp & region);
+        }
+        label_region(region, [&count](Move) { count++; });
+        return count;
+    }
+
+    bool operator==(const BasicPackedBoard& rh) const {
+        return planes == rh.planes;
+    }
+
+    // Clears every square in mask and lets the touched columns fall.
+    void remove(uint64_t mask) {
+#ifdef __BMI2__
+        // Gather the survivors of all columns with one pext per plane, then
+        // scatter them to the bottom of their columns with one pdep.
+        const uint64_t keep = occupied() & ~mask;
+        uint64_t target = keep;
+        for (uint64_t dirty = mask; dirty;) {
+            const int shift = (__builtin_ctzll(dirty) / H) * H;
+            const uint64_t col = COLUMN << shift;
+            const int height = __builtin_popcountll(keep & col);
+            target = (target & ~col) | (((1ull << height) - 1) << shift);
+            dirty &= ~col;
+        }
+        for (auto& p : planes) {
+            p = _pdep_u64(_pext_u64(p, keep), target);
+        }
+#else
+        // Drop the removed squares highest first, so the bits still to be
+        // removed below them keep their positions.
+        while (mask) {
+            const int b = 63 - __builtin_clzll(mask);
+            const uint64_t col = column(b / H);
+            const uint64_t below = col & ((1ull << b) - 1);
+            const uint64_t above = col & ~below & ~(1ull << b);
+            for (auto& p : planes) {
+                p = (p & ~col) | (p & below) | ((p & above) >> 1);
+            }
+            mask &= ~(1ull << b);
+        }
+#endif
+    }
+};
+
+template<int W, int H>
+std::ostream& operator<<(std::ostream& os, const BasicPackedBoard<W, H>& brd) {
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            os << toLetter(brd.at(Coord(x, y))) << ' ';
+        }
+        os << '\n';
+    }
+    return os;
+}
+
+typedef BasicPackedBoard<HSIZE, VSIZE> PackedBoard;
+
+// One board of the batch format: the squares row by row from the top,
+// one toLetter() character each, '-' for empty. Whitespace is ignored.
+template<int W, int H>
+bool parse_board(const std::string& text, BasicPackedBoard<W, H>& out) {
+    typedef BasicPackedBoard<W, H> PackedBoard;
+    static const std::string letters = "-RGBY";
+    out = PackedBoard();
+    int i = 0;
+    for (char ch : text) {
+        if (std::isspace(static_cast<unsigned char>(ch))) {
+            continue;
+        }
+        const std::size_t sq = letters.find(ch);
+        if (sq == std::string::npos || i >= W * H) {
+            return false;
+        }
+        if (sq) {
+            out.planes[sq - 1] |= PackedBoard::cell(i % W, i / W);
+        }
+        i++;
+    }
+    // Every column must already have fallen: no square above a hole.
+    for (int x = 0; x < W; x++) {
+        const uint64_t col = (out.occupied() >> (x * H)) & PackedBoard::COLUMN;
+        if (col & (col + 1)) {
+            return false;
+        }
+    }
+    return i == W * H;
+}
+
+// A board size as a type, for handing compile time sizes to generic code.
+template<int W, int H>
+struct BoardSize {
+    static constexpr int width = W;
+    static constexpr int height = H;
+};
+
+// Calls f with the BoardSize matching width x height, so a size chosen at
+// runtime still reaches code compiled for that exact size. Returns false
+// for sizes without a compiled solver.
+template<class F>
+bool with_board_size(int width, int height, F f) {
+    if (width == 7 && height == 9) { f(BoardSize<7, 9>()); return true; } // the daily board
+    if (width == 6 && height == 8) { f(BoardSize<6, 8>()); return true; }
+    if (width == 5 && height == 7) { f(BoardSize<5, 7>()); return true; }
+    if (width == 5 && height == 5) { f(BoardSize<5, 5>()); return true; }
+    if (width == 4 && height == 4) { f(BoardSize<4, 4>()); return true; }
+    return false;
+}
+
+// The sizes with_board_size() accepts, for messages.
+static constexpr const char* BOARD_SIZES = "7x9, 6x8, 5x7, 5x5, 4x4";
@@ -5,24 +5,13 @@
 #include <vector>
 #include <iostream>
 #include <numeric>
+#include <algorithm>
+#include <chrono>
 #include "board_annotate.hpp"
 
 namespace Annotator {
 
 // ----- Hue utilities -----
-static inline double circularMeanDegrees(const std::vector<double>& degs) {
-    if (degs.empty()) return 0.0;
-    double sx = 0.0, sy = 0.0;
-    for (double d : degs) {
-        double r = d * CV_PI / 180.0;
-        sx += std::cos(r);
-        sy += std::sin(r);
-    }
-    double ang = std::atan2(sy, sx);
-    if (ang < 0) ang += 2 * CV_PI;
-    return ang * 180.0 / CV_PI;
-}
-
 static inline uint8_t hueToLetter(double deg) {
     // Primary bands
     if (deg >= 310 || deg < 15)   return R;  // Pink
@@ -45,63 +34,163 @@ static inline uint8_t hueToLetter(double deg) {
     return best;
 }
 
+// Distance in degrees from deg to the nearest edge of its band above; 0
+// between the bands, where the letter is only the nearest prototype's.
+static inline double hueMargin(double deg) {
+    static const double bands[4][2] = {{310, 375}, {15, 55}, {80, 165}, {175, 220}};
+    for (const auto& band : bands) {
+        const double d = deg < band[0] ? deg + 360 : deg; // red wraps around 0
+        if (d < band[1]) return std::min(d - band[0], band[1] - d);
+    }
+    return 0;
+}
+
+// Label of an empty square, as in the solver's boards.
+static constexpr uint8_t EMPTY = 0;
+
+// OpenCV 8-bit hue has 180 values (2 degrees each). Everything the
+// classifier needs per hue value is tabulated once.
+static constexpr int HUE_BINS = 180;
+
+struct HueTables {
+    double cosv[HUE_BINS];
+    double sinv[HUE_BINS];
+    uint8_t letter[HUE_BINS];
+    HueTables() {
+        for (int h = 0; h < HUE_BINS; ++h) {
+            double r = h * 2.0 * CV_PI / 180.0;
+            cosv[h] = std::cos(r);
+            sinv[h] = std::sin(r);
+            letter[h] = hueToLetter(h * 2.0);
+        }
+    }
+};
+
+static const HueTables& hueTables() {
+    static const HueTables tables;
+    return tables;
+}
+
+// Circular mean, in degrees, of a hue histogram.
+static inline double circularMeanDegrees(const int* hist) {
+    const HueTables& T = hueTables();
+    double sx = 0.0, sy = 0.0;
+    for (int h = 0; h < HUE_BINS; ++h) {
+        sx += hist[h] * T.cosv[h];
+        sy += hist[h] * T.sinv[h];
+    }
+    double ang = std::atan2(sy, sx);
+    if (ang < 0) ang += 2 * CV_PI;
+    return ang * 180.0 / CV_PI;
+}
+
+// Share of a histogram's colored pixels whose own hue gives label.
+static inline float agreeingShare(const int* hist, int colored, uint8_t label) {
+    const HueTables& T = hueTables();
+    int agree = 0;
+    for (int h = 0; h < HUE_BINS; ++h) {
+        agree += T.letter[h] == label ? hist[h] : 0;
+    }
+    return colored ? static_cast<float>(agree) / colored : 0.0f;
+}
+
+// Inner crop of cell (r, c) used for color sampling.
+static cv::Rect innerCellRect(int r, int c, double cellW, double cellH,
+                              const Params& P, const cv::Size& size)
+{
+    int x0 = static_cast<int>(std::floor(c * cellW));
+    int y0 = static_cast<int>(std::floor(r * cellH));
+    int x1 = static_cast<int>(std::floor((c + 1) * cellW));
+    int y1 = static_cast<int>(std::floor((r + 1) * cellH));
+
+    int iw = x1 - x0, ih = y1 - y0;
+    int ix0 = x0 + static_cast<int>((1.0 - P.innerRatio) * 0.5 * iw);
+    int iy0 = y0 + static_cast<int>((1.0 - P.innerRatio) * 0.5 * ih);
+    int ix1 = x1 - static_cast<int>((1.0 - P.innerRatio) * 0.5 * iw);
+    int iy1 = y1 - static_cast<int>((1.0 - P.innerRatio) * 0.5 * ih);
+
+    cv::Rect roi(std::max(0, ix0), std::max(0, iy0),
+                 std::max(1, ix1 - ix0), std::max(1, iy1 - iy0));
+    return roi & cv::Rect(0, 0, size.width, size.height);
+}
+
+// Inner crops of every cell of an image of this size, row by row.
+static std::vector<cv::Rect> cellRects(const cv::Size& size, const Params& P)
+{
+    const double cellW = static_cast<double>(size.width) / P.cols;
+    const double cellH = static_cast<double>(size.height) / P.rows;
+    std::vector<cv::Rect> rects;
+    rects.reserve(P.rows * P.cols);
+    for (int r = 0; r < P.rows; ++r) {
+        for (int c = 0; c < P.cols; ++c) {
+            rects.push_back(innerCellRect(r, c, cellW, cellH, P, size));
+        }
+    }
+    return rects;
+}
+
+static std::vector<int> allCells(const Params& P)
+{
+    std::vector<int> cells(P.rows * P.cols);
+    std::iota(cells.begin(), cells.end(), 0);
+    return cells;
+}
+
 // ----- Core: analyze one board -----
-std::vector<std::vector<uint8_t>> analyzeBoard(
-    const cv::Mat& bgr, const Params& P)
+// Each of the given cells builds a hue histogram of the colored pixels of
+// its inner crop, in parallel. The label is the circular mean hue's
+// letter; the confidence is the share of colored pixels whose own hue
+// gives that letter (0 when the cell had none and the label comes from
+// the patch's mean color). A cell without colored pixels whose mean color
+// is dark too is an empty square: EMPTY, with confidence 1. Classifying
+// every cell converts the image to HSV once and indexes the crops; a few
+// unsure cells convert only their own crops.
+static void classifyInto(const cv::Mat& bgr, const std::vector<cv::Rect>& rects,
+                         const std::vector<int>& cells, const Params& P, const CellGrid& out)
 {
     CV_Assert(!bgr.empty());
-    const int rows = P.rows, cols = P.cols;
-
-    const double cellW = static_cast<double>(bgr.cols) / cols;
-    const double cellH = static_cast<double>(bgr.rows) / rows;
+    const int cols = P.cols;
+    // S > satMin * 255 and V > valMin * 255, as integer thresholds
+    const cv::Scalar low(0, std::floor(P.satMin * 255.0) + 1, std::floor(P.valMin * 255.0) + 1);
+    const cv::Scalar high(255, 255, 255);
+
+    const bool whole = cells.size() == rects.size();
+    cv::Mat wholeHsv, wholeMask;
+    if (whole) {
+        cv::cvtColor(bgr, wholeHsv, cv::COLOR_BGR2HSV); // H: 0..179
+        cv::inRange(wholeHsv, low, high, wholeMask);
+    }
 
-    std::vector<std::vector<uint8_t>> labels(rows, std::vector<uint8_t>(cols, 0));
+    cv::parallel_for_(cv::Range(0, static_cast<int>(cells.size())), [&](const cv::Range& range) {
+        cv::Mat hsv, mask;
+        for (int k = range.start; k < range.end; ++k) {
+            const int i = cells[k];
+            const int r = i / cols, c = i % cols;
+            const cv::Rect& roi = rects[i];
+            if (whole) {
+                hsv = wholeHsv(roi);
+                mask = wholeMask(roi);
+            } else {
+                cv::cvtColor(bgr(roi), hsv, cv::COLOR_BGR2HSV);
+                cv::inRange(hsv, low, high, mask);
+            }
 
-    for (int r = 0; r < rows; ++r) {
-        for (int c = 0; c < cols; ++c) {
-            int x0 = static_cast<int>(std::floor(c * cellW));
-            int y0 = static_cast<int>(std::floor(r * cellH));
-            int x1 = static_cast<int>(std::floor((c + 1) * cellW));
-            int y1 = static_cast<int>(std::floor((r + 1) * cellH));
-
-            // inner crop for color sampling
-            int iw = x1 - x0, ih = y1 - y0;
-            int ix0 = x0 + static_cast<int>((1.0 - P.innerRatio) * 0.5 * iw);
-            int iy0 = y0 + static_cast<int>((1.0 - P.innerRatio) * 0.5 * ih);
-            int ix1 = x1 - static_cast<int>((1.0 - P.innerRatio) * 0.5 * iw);
-            int iy1 = y1 - static_cast<int>((1.0 - P.innerRatio) * 0.5 * ih);
-
-            cv::Rect roi(std::max(0, ix0), std::max(0, iy0),
-                         std::max(1, ix1 - ix0), std::max(1, iy1 - iy0));
-            roi &= cv::Rect(0,0,bgr.cols,bgr.rows);
-
-            cv::Mat patchBGR = bgr(roi);
-            cv::Mat patchHSV;
-            cv::cvtColor(patchBGR, patchHSV, cv::COLOR_BGR2HSV);
-
-            std::vector<cv::Mat> ch; cv::split(patchHSV, ch); // H,S,V (H: 0..179)
-            const double Sthr = P.satMin * 255.0;
-            const double Vthr = P.valMin * 255.0;
-            cv::Mat mask = (ch[1] > Sthr) & (ch[2] > Vthr);
-
-            std::vector<double> huesDeg;
-            huesDeg.reserve(static_cast<size_t>(mask.total()));
-
-            for (int y = 0; y < mask.rows; ++y) {
+            // Masked out pixels go to the extra bin, so the loop has no branch.
+            int hist[HUE_BINS + 1] = {0};
+            for (int y = 0; y < roi.height; ++y) {
+                const cv::Vec3b* hptr = hsv.ptr<cv::Vec3b>(y);
                 const uchar* mptr = mask.ptr<uchar>(y);
-                const uchar* hptr = ch[0].ptr<uchar>(y);
-                for (int x = 0; x < mask.cols; ++x) {
-                    if (mptr[x]) {
-                        // OpenCV hue 0..179 maps to 0..360
-                        huesDeg.push_back(hptr[x] * 2.0);
-                    }
+                for (int x = 0; x < roi.width; ++x) {
+                    hist[mptr[x] ? hptr[x][0] : HUE_BINS]++;
                 }
             }
+            const int colored = roi.area() - hist[HUE_BINS];
 
             double hueDeg;
-            if (huesDeg.empty()) {
+            bool empty = false;
+            if (colored == 0) {
                 // Fallback: mean color of the patch
-                cv::Scalar meanBGR = cv::mean(patchBGR);
+                cv::Scalar meanBGR = cv::mean(bgr(roi));
                 cv::Mat one(1,1,CV_8UC3, cv::Vec3b(
                     (uchar)std::clamp((int)std::round(meanBGR[0]), 0, 255),
                     (uchar)std::clamp((int)std::round(meanBGR[1]), 0, 255),
@@ -110,14 +199,241 @@ std::vector<std::vector<uint8_t>> analyzeBoard(
                 cv::Mat oneHSV;
                 cv::cvtColor(one, oneHSV, cv::COLOR_BGR2HSV);
                 hueDeg = oneHSV.at<cv::Vec3b>(0,0)[0] * 2.0;
+                empty = oneHSV.at<cv::Vec3b>(0,0)[2] < low[2];
             } else {
-                hueDeg = circularMeanDegrees(huesDeg);
+                hueDeg = circularMeanDegrees(hist);
+            }
+
+            const uint8_t label = empty ? EMPTY : hueToLetter(hueDeg);
+            const int at = r * out.rowStride + c * out.colStride;
+            out.labels[at] = label;
+            if (out.confidence) {
+                out.confidence[at] = empty ? 1.0f : agreeingShare(hist, colored, label);
             }
+        }
+    });
+}
 
-            labels[r][c] = hueToLetter(hueDeg);
+static void classifyInto(const cv::Mat& bgr, const std::vector<cv::Rect>& rects,
+                         const Params& P, const CellGrid& out)
+{
+    classifyInto(bgr, rects, allCells(P), P, out);
+}
+
+// ----- Fast path: a lattice of samples per cell -----
+// Classifies every cell like classifyInto(), but from P.lattice x
+// P.lattice pixels spread evenly over its inner crop, all converted to HSV
+// at once. A cell whose samples are all dark is an empty square. Returns
+// the cells left unsure: with bright samples but no colored one, with
+// less than P.minConfidence of them agreeing, or with the mean hue within
+// P.minMargin degrees of a band edge. Those are for classifyInto().
+static std::vector<int> sampleInto(const cv::Mat& bgr, const std::vector<cv::Rect>& rects,
+                                   const Params& P, const CellGrid& out)
+{
+    CV_Assert(!bgr.empty() && bgr.type() == CV_8UC3);
+    const int cells = P.rows * P.cols;
+    const int n = std::max(1, P.lattice);
+
+    // One row of samples per cell
+    cv::Mat samples(cells, n * n, CV_8UC3);
+    for (int i = 0; i < cells; ++i) {
+        const cv::Rect& roi = rects[i];
+        cv::Vec3b* sptr = samples.ptr<cv::Vec3b>(i);
+        for (int sy = 0; sy < n; ++sy) {
+            const cv::Vec3b* row = bgr.ptr<cv::Vec3b>(roi.y + (2 * sy + 1) * roi.height / (2 * n));
+            for (int sx = 0; sx < n; ++sx) {
+                sptr[sy * n + sx] = row[roi.x + (2 * sx + 1) * roi.width / (2 * n)];
+            }
+        }
+    }
+    cv::Mat hsv;
+    cv::cvtColor(samples, hsv, cv::COLOR_BGR2HSV); // H: 0..179
+    const int satMin = static_cast<int>(std::floor(P.satMin * 255.0)) + 1;
+    const int valMin = static_cast<int>(std::floor(P.valMin * 255.0)) + 1;
+
+    std::vector<int> unsure;
+    for (int i = 0; i < cells; ++i) {
+        const cv::Vec3b* hptr = hsv.ptr<cv::Vec3b>(i);
+        int hist[HUE_BINS] = {0};
+        int colored = 0, dark = 0;
+        for (int k = 0; k < n * n; ++k) {
+            if (hptr[k][1] >= satMin && hptr[k][2] >= valMin) {
+                hist[hptr[k][0]]++;
+                colored++;
+            }
+            dark += hptr[k][2] < valMin;
+        }
+        const int at = (i / P.cols) * out.rowStride + (i % P.cols) * out.colStride;
+        if (dark == n * n) {
+            out.labels[at] = EMPTY;
+            if (out.confidence) {
+                out.confidence[at] = 1.0f;
+            }
+            continue;
+        }
+        if (colored == 0) {
+            unsure.push_back(i);
+            continue;
         }
+        const double hueDeg = circularMeanDegrees(hist);
+        const uint8_t label = hueToLetter(hueDeg);
+        const float confidence = agreeingShare(hist, colored, label);
+        out.labels[at] = label;
+        if (out.confidence) {
+            out.confidence[at] = confidence;
+        }
+        if (confidence < P.minConfidence || hueMargin(hueDeg) < P.minMargin) {
+            unsure.push_back(i);
+        }
+    }
+    return unsure;
+}
+
+static void classifyInto(const cv::Mat& bgr, const Params& P, const CellGrid& out)
+{
+    CV_Assert(!bgr.empty());
+    classifyInto(bgr, cellRects(bgr.size(), P), P, out);
+}
+
+// Row major labels and confidence as one row per board row.
+static Analysis toAnalysis(const std::vector<uint8_t>& labels, const std::vector<float>& confidence,
+                           const Params& P)
+{
+    Analysis out;
+    for (int r = 0; r < P.rows; ++r) {
+        out.labels.emplace_back(labels.begin() + r * P.cols, labels.begin() + (r + 1) * P.cols);
+        out.confidence.emplace_back(confidence.begin() + r * P.cols, confidence.begin() + (r + 1) * P.cols);
+    }
+    return out;
+}
+
+Analysis analyzeBoardWithConfidence(const cv::Mat& bgr, const Params& P)
+{
+    std::vector<uint8_t> labels(P.rows * P.cols);
+    std::vector<float> confidence(P.rows * P.cols);
+    classifyInto(bgr, P, CellGrid{labels.data(), P.cols, 1, confidence.data()});
+    return toAnalysis(labels, confidence, P);
+}
+
+std::vector<std::vector<uint8_t>> analyzeBoard(
+    const cv::Mat& bgr, const Params& P)
+{
+    return analyzeBoardWithConfidence(bgr, P).labels;
+}
+
+// ----- Streaming -----
+struct BoardStream::Impl {
+    cv::VideoCapture capture;
+    Params P;
+    cv::Size frameSize;             // geometry below is for this size
+    std::vector<cv::Rect> rects;
+    cv::Mat frame, thumb, previousThumb, classifiedThumb;
+    std::vector<uint8_t> labels, lastLabels; // row major
+    std::vector<float> confidence;
+    bool any = false;               // a board has been returned
+};
+
+// Thumbnail pixels per side of a cell.
+static constexpr int THUMB_CELL = 4;
+
+// A frame counts as changed when the mean gray level difference of some
+// cell's block of its thumbnail from the other one's exceeds
+// P.frameChange. Compared per cell, one square falling is a change however
+// large the board is.
+static bool framesDiffer(const cv::Mat& a, const cv::Mat& b, const Params& P) {
+    if (a.empty() || b.empty()) {
+        return true;
+    }
+    for (int r = 0; r < P.rows; ++r) {
+        for (int c = 0; c < P.cols; ++c) {
+            const cv::Rect block(c * THUMB_CELL, r * THUMB_CELL, THUMB_CELL, THUMB_CELL);
+            if (cv::norm(a(block), b(block), cv::NORM_L1) / block.area() > P.frameChange) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+BoardStream::BoardStream(const std::string& source, const Params& P) : impl(new Impl) {
+    impl->P = P;
+    const bool camera = !source.empty() && source.find_first_not_of("0123456789") == std::string::npos;
+    if (camera ? !impl->capture.open(std::stoi(source)) : !impl->capture.open(source)) {
+        throw std::runtime_error("Failed to open stream: " + source);
+    }
+    impl->labels.resize(P.rows * P.cols);
+    impl->confidence.resize(P.rows * P.cols);
+}
+
+BoardStream::~BoardStream() = default;
+
+bool BoardStream::next(const CellGrid& out, StreamStats* stats) {
+    typedef std::chrono::steady_clock Clock;
+    Impl& s = *impl;
+    const int cells = s.P.rows * s.P.cols;
+    while (true) {
+        const auto t0 = Clock::now();
+        if (!s.capture.read(s.frame) || s.frame.empty()) {
+            return false;
+        }
+        const auto t1 = Clock::now();
+        if (stats) {
+            stats->frames++;
+            stats->decodeMs += std::chrono::duration<double, std::milli>(t1 - t0).count();
+        }
+        if (s.frame.size() != s.frameSize) {
+            s.frameSize = s.frame.size();
+            s.rects = cellRects(s.frameSize, s.P);
+            s.previousThumb.release();
+            s.classifiedThumb.release();
+        }
+
+        // A few pixels per cell are enough to see whether anything moved.
+        cv::Mat small;
+        cv::resize(s.frame, small, cv::Size(s.P.cols * THUMB_CELL, s.P.rows * THUMB_CELL), 0, 0, cv::INTER_AREA);
+        cv::cvtColor(small, s.thumb, cv::COLOR_BGR2GRAY);
+        const bool moving = !s.previousThumb.empty() && framesDiffer(s.thumb, s.previousThumb, s.P);
+        s.thumb.copyTo(s.previousThumb);
+        if (moving) {
+            // Squares still falling: wait for the board to settle.
+            if (stats) stats->moving++;
+            continue;
+        }
+        if (!framesDiffer(s.thumb, s.classifiedThumb, s.P)) {
+            if (stats) stats->unchanged++;
+            continue;
+        }
+        s.thumb.copyTo(s.classifiedThumb);
+
+        const CellGrid grid{s.labels.data(), s.P.cols, 1, s.confidence.data()};
+        if (s.P.fast) {
+            const std::vector<int> unsure = sampleInto(s.frame, s.rects, s.P, grid);
+            if (!unsure.empty()) {
+                classifyInto(s.frame, s.rects, unsure, s.P, grid);
+            }
+            if (stats) stats->fallbackCells += unsure.size();
+        } else {
+            classifyInto(s.frame, s.rects, s.P, grid);
+        }
+        if (stats) {
+            stats->classified++;
+            stats->classifyMs += std::chrono::duration<double, std::milli>(Clock::now() - t1).count();
+        }
+        if (s.any && s.labels == s.lastLabels) {
+            continue;
+        }
+        s.lastLabels = s.labels;
+        s.any = true;
+        for (int i = 0; i < cells; ++i) {
+            const int at = (i / s.P.cols) * out.rowStride + (i % s.P.cols) * out.colStride;
+            out.labels[at] = s.labels[i];
+            if (out.confidence) {
+                out.confidence[at] = s.confidence[i];
+            }
+        }
+        if (stats) stats->boards++;
+        return true;
     }
-    return labels;
 }
 
 // ----- Centroid of shape inside a cell -----
@@ -134,11 +450,53 @@ static inline cv::Point2d cellCentroid(const cv::Mat& cellBGR, double satMin, do
 }
 
 std::vector<std::vector<uint8_t>> analyzeBoard(const std::string& imagePath, Params P){
-    cv::Mat bgr = cv::imread(imagePath, cv::IMREAD_COLOR);
+    return analyzeBoardWithConfidence(imagePath, P).labels;
+}
+
+Analysis analyzeBoardWithConfidence(const std::string& imagePath, Params P){
+    std::vector<uint8_t> labels(P.rows * P.cols);
+    std::vector<float> confidence(P.rows * P.cols);
+    analyzeImageInto(imagePath, P, CellGrid{labels.data(), P.cols, 1, confidence.data()});
+    return toAnalysis(labels, confidence, P);
+}
+
+static cv::Mat readImage(const std::string& imagePath, int flags)
+{
+    cv::Mat bgr = cv::imread(imagePath, flags);
     if (bgr.empty()) {
         throw std::runtime_error("Failed to read image: " + imagePath);
     }
-    return analyzeBoard(bgr, P);
+    return bgr;
+}
+
+// With P.fast the image is decoded at a quarter of its size (JPEG scales
+// while decoding) and sampled on the lattice; it is only decoded in full
+// if some cell was unsure, and then only those cells use every pixel.
+void analyzeImageInto(const std::string& imagePath, const Params& P,
+                      const CellGrid& out, Timings* timings)
+{
+    typedef std::chrono::steady_clock Clock;
+    const auto t0 = Clock::now();
+    const cv::Mat bgr = readImage(imagePath, P.fast ? cv::IMREAD_REDUCED_COLOR_4 : cv::IMREAD_COLOR);
+    const auto t1 = Clock::now();
+    std::vector<int> unsure;
+    if (P.fast) {
+        unsure = sampleInto(bgr, cellRects(bgr.size(), P), P, out);
+    } else {
+        classifyInto(bgr, P, out);
+    }
+    const auto t2 = Clock::now();
+    if (!unsure.empty()) {
+        const cv::Mat full = readImage(imagePath, cv::IMREAD_COLOR);
+        classifyInto(full, cellRects(full.size(), P), unsure, P, out);
+    }
+    const auto t3 = Clock::now();
+    if (timings) {
+        timings->decodeMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        timings->classifyMs = std::chrono::duration<double, std::milli>(t2 - t1).count();
+        timings->fallbackMs = std::chrono::duration<double, std::milli>(t3 - t2).count();
+        timings->fallbackCells = static_cast<int>(unsure.size());
+    }
 }
 
 // ----- Draw outlined text (stroke + fill) -----
@@ -162,16 +520,16 @@ static inline void drawCenteredLetter(cv::Mat& img, const std::string& letter,
     cv::putText(img, letter, org, fontFace, fontScale, fill,   fillThickness,   cv::LINE_AA);
 }
 
-// ----- Render labels on the board -----
-std::string renderLabelsOnBoard(const cv::Mat& bgr,
-                                const std::vector<std::vector<uint8_t>>& labels,
-                                const std::string& outPath,
-                                bool drawGrid = false,
-                                const Params& P = Params{})
+// ----- Render text on the board's cells -----
+static void renderTextOnBoard(const cv::Mat& bgr,
+                              const std::vector<std::vector<std::string>>& texts,
+                              const std::string& outPath,
+                              bool drawGrid,
+                              const Params& P)
 {
     CV_Assert(!bgr.empty());
-    int rows = (int)labels.size();
-    int cols = rows ? (int)labels[0].size() : 0;
+    int rows = (int)texts.size();
+    int cols = rows ? (int)texts[0].size() : 0;
     CV_Assert(rows == P.rows && cols == P.cols);
 
     cv::Mat canvas = bgr.clone();
@@ -194,9 +552,8 @@ std::string renderLabelsOnBoard(const cv::Mat& bgr,
             cv::Point2d localC = cellCentroid(cell, P.satMin, P.valMin);
             cv::Point2d globalC(x0 + localC.x, y0 + localC.y);
 
-            // Draw letter
-            std::string ch(1, labels[r][c]);
-            drawCenteredLetter(canvas, ch, globalC, cellMin);
+            // Draw text
+            drawCenteredLetter(canvas, texts[r][c], globalC, cellMin);
 
             if (drawGrid) {
                 cv::rectangle(canvas, cellRect, cv::Scalar(255,255,255), 2, cv::LINE_AA);
@@ -207,9 +564,48 @@ std::string renderLabelsOnBoard(const cv::Mat& bgr,
     if (!outPath.empty()) {
         cv::imwrite(outPath, canvas);
     }
+}
+
+static const char* LETTERS = "-RGBY";
+
+// ----- Render labels on the board -----
+std::string renderLabelsOnBoard(const cv::Mat& bgr,
+                                const std::vector<std::vector<uint8_t>>& labels,
+                                const std::string& outPath,
+                                bool drawGrid = false,
+                                const Params& P = Params{})
+{
+    std::vector<std::vector<std::string>> texts;
+    for (const auto& row : labels) {
+        texts.emplace_back();
+        for (uint8_t label : row) {
+            texts.back().emplace_back(1, LETTERS[label]);
+        }
+    }
+    renderTextOnBoard(bgr, texts, outPath, drawGrid, P);
     return outPath;
 }
 
+void renderSolution(const std::string& imagePath, const Params& P, const CellGrid& labels,
+                    const std::vector<std::pair<int, int>>& moves, const std::string& outPath)
+{
+    cv::Mat bgr = cv::imread(imagePath, cv::IMREAD_COLOR);
+    if (bgr.empty()) {
+        throw std::runtime_error("Failed to read image: " + imagePath);
+    }
+    std::vector<std::vector<std::string>> texts(P.rows, std::vector<std::string>(P.cols));
+    for (int r = 0; r < P.rows; ++r) {
+        for (int c = 0; c < P.cols; ++c) {
+            texts[r][c] = LETTERS[labels.labels[r * labels.rowStride + c * labels.colStride]];
+        }
+    }
+    // A tapped square is removed, so every square has at most one number.
+    for (size_t i = 0; i < moves.size(); ++i) {
+        texts[moves[i].first][moves[i].second] = std::to_string(i + 1);
+    }
+    renderTextOnBoard(bgr, texts, outPath, true, P);
+}
+
 // ----- Convenience: analyze + annotate -----
 std::pair<std::vector<std::vector<uint8_t>>, std::string>
 analyzeAndAnnotate(const std::string& imagePath,
@@ -1,5 +1,9 @@
-
-
+#pragma once
+#include <stdint-gcc.h>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 #define R 1
 #define G 2
 #define B 3
@@ -16,7 +20,90 @@ struct Params {
     double innerRatio = 0.60; // central crop ratio for color sampling
     double satMin = 0.50;     // HSV S threshold to ignore background
     double valMin = 0.50;     // HSV V threshold to ignore background
+    double frameChange = 3.0; // streaming: mean gray level change of a cell that counts as a new frame
+    // Fast path: each cell is first classified from a lattice of samples
+    // (of an image decoded at a quarter of its size), and only cells that
+    // are unsure by the two limits below are classified again from every
+    // pixel at full resolution.
+    bool fast = true;
+    int lattice = 6;            // samples per side of each cell's inner crop
+    double minConfidence = 0.8; // unsure below this share of agreeing samples
+    double minMargin = 5.0;     // unsure with the mean hue closer (degrees) to a band edge
+};
+
+// Labels and confidence per cell, both indexed [row][col]. Confidence is
+// the share (0..1) of the cell's colored pixels agreeing with its label.
+// An empty square (dark, without colored pixels) is 0 with confidence 1.
+struct Analysis {
+    std::vector<std::vector<uint8_t>> labels;
+    std::vector<std::vector<float>> confidence;
+};
+
+// Where a classification is written: the label of cell (row, col) goes to
+// labels[row * rowStride + col * colStride], and its confidence likewise
+// to confidence if that is set. The caller's own board can be the
+// destination, whatever its layout.
+struct CellGrid {
+    uint8_t* labels;
+    int rowStride;
+    int colStride;
+    float* confidence = nullptr;
+};
+
+// Milliseconds spent in each stage of analyzeImageInto().
+// With the fast path, decode and classify are those of the reduced image,
+// and fallback covers decoding and classifying the unsure cells again.
+struct Timings {
+    double decodeMs = 0;
+    double classifyMs = 0;
+    double fallbackMs = 0;
+    int fallbackCells = 0;
 };
 
 std::vector<std::vector<uint8_t>> analyzeBoard(const std::string& imagePath, Params P);
+Analysis analyzeBoardWithConfidence(const std::string& imagePath, Params P);
+
+// Decodes imagePath and classifies its cells straight into out.
+// Throws std::runtime_error if the image cannot be read.
+void analyzeImageInto(const std::string& imagePath, const Params& P,
+                      const CellGrid& out, Timings* timings = nullptr);
+
+// Draws every cell's letter onto the image, and each move's number on the
+// square it taps, as (row, col) in the image, not on the fallen board of
+// that moment; then writes the result to outPath. The image is decoded
+// again.
+void renderSolution(const std::string& imagePath, const Params& P, const CellGrid& labels,
+                    const std::vector<std::pair<int, int>>& moves, const std::string& outPath);
+// Counters of a BoardStream, summed over all frames read so far.
+struct StreamStats {
+    long frames = 0;     // frames decoded
+    long moving = 0;     // skipped: differed from the frame before (animation)
+    long unchanged = 0;  // skipped: same as the last frame classified
+    long classified = 0; // frames classified
+    long boards = 0;     // classified to a different board and returned
+    long fallbackCells = 0; // fast path: cells classified again from every pixel
+    double decodeMs = 0;
+    double classifyMs = 0;
+};
+
+// Follows a live game: reads frames from a video file, a camera index
+// ("0") or an image sequence such as "frames/%04d.png" through
+// cv::VideoCapture. Cell geometry is computed once per frame size, and
+// frames are only classified once the picture has settled and differs
+// from the last one classified. With P.fast, frames are sampled on the
+// lattice and only unsure cells use every pixel.
+class BoardStream {
+public:
+    // Throws std::runtime_error if source cannot be opened.
+    BoardStream(const std::string& source, const Params& P);
+    ~BoardStream();
+
+    // Classifies into out the next frame showing a board different from
+    // the last one returned. False at the end of the stream.
+    bool next(const CellGrid& out, StreamStats* stats = nullptr);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
 } // namespace Annotator
@@ -5,342 +5,736 @@
 #include <vector>
 #include <algorithm>
 #include <sys/resource.h>
-#include <stack>
+#include <atomic>
 #include <chrono>
-#include "board_annotate.hpp"
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <climits>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "board.hpp"
+#include "reference_boards.hpp"
+#include "search.hpp"
+#include "tablebase.hpp"
 
-static constexpr char toLetter(uint8_t sq) {
-    return "-RGBY"[sq];
-}
-
-typedef uint8_t Square;
-typedef std::pair<int,int> Coord;
-typedef std::vector<Coord> Move;
+struct Options {
+    std::size_t tt_mb = 64;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    bool exact = false;
+    std::size_t beam = 0; // beam width, 0 for the depth first search
+    int nrpa = 0;         // rollout search level, 0 for none
+    std::vector<Strategy> portfolio; // members to race, none for one search
+    SearchPolicy policy; // of the depth first search
+    double budget_ms = 0;
+    uint64_t budget_states = 0;
+    std::string stats_file;
+    std::string render_file;
+    bool full_res = false; // classify images from every pixel, without the fast path
+    const Tablebase* tablebase = nullptr; // endgames, for the size being solved
+};
 
-std::ostream& operator<<(std::ostream& os, const Coord& co) {
-    os << "(" << co.first << "," << co.second << ")";
-    return os;
-}
+template<int W, int H>
+static BasicPath<W, H> solve(const BasicPackedBoard<W, H>& board, const Options& opt,
+                             WorkStealingPool& pool, TranspositionTable& tt,
+                             std::ostream& log = std::cout, uint64_t* states = nullptr);
 
-class Vertical : public std::array<Square, VSIZE> {
-public:
-    Vertical(const std::array<Square, VSIZE>& ref) : std::array<Square, VSIZE>(ref) {}
-    void fall(){
-        for(auto it = this->rbegin(); it != this->rend();) {
-            if(*it == 0){
-                bool all_zero = true;
-                for(auto x = it; x != this->rend(); x++){
-                    if(*x){
-                        all_zero = false;
-                        break;
-                    }
-                }
-                if(all_zero){
-                    break;
-                }
-                for(auto it2 = it; it2 != (this->rend() - 1); it2++) {
-                    *it2 = *(it2 + 1);
-                }
-                *this->begin() = 0;
-            } else {
-                it++;
-            }
+// Solves every board read from source ("-" for stdin), one board per task
+// so all workers stay busy, and prints each result as soon as it is done.
+// The other engines and the anytime search use every worker on one board,
+// so with those the boards are solved one after another by solve().
+// Every board of a batch has the size W x H.
+template<int W, int H>
+static int run_batch(const std::string& source, const Options& opt) {
+    std::ifstream file;
+    std::istream* in = &std::cin;
+    if (source != "-") {
+        file.open(source);
+        if (!file) {
+            std::cerr << "Failed to open " << source << "\n";
+            return 1;
         }
+        in = &file;
     }
-};
 
-class Board : public std::array<Vertical, HSIZE>{
-public:
-    Board(const std::array<Vertical, HSIZE>& ref) : std::array<Vertical, HSIZE>(ref) {}
-    void fall() {
-        for(auto& elem : *this){
-            elem.fall();
+    typedef BasicPackedBoard<W, H> PackedBoard;
+    typedef BasicGame<W, H> Game;
+    typedef BasicSearch<W, H> Search;
+    struct Worker {
+        std::atomic<bool> done{false};
+        Search search;
+        Worker(TranspositionTable& tt, const Options& opt) : search(tt, done) {
+            search.tablebase = opt.tablebase;
+            search.policy = opt.policy;
         }
+    };
+    TranspositionTable tt(opt.tt_mb);
+    WorkStealingPool pool(opt.threads);
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (int i = 0; i < pool.size(); i++) {
+        workers.emplace_back(new Worker(tt, opt));
     }
-    Square at(const Coord co) {
-#if 0 // Bounds checking
-        return this->std::array<Vertical, HSIZE>::at(co.first).at(co.second);
-#else // YOLO
-        return (*this)[co.first][co.second];
-#endif
-    }
-};
 
-std::ostream& operator<<(std::ostream& os, const Board& arr) {
-    for (int y = 0; y < VSIZE; y++) {
-        for (int x = 0; x < HSIZE; x++) {
-            os << toLetter(arr[x][y]) << ' ';
+    std::mutex out_mutex;
+    std::atomic<uint64_t> total_states{0};
+    std::atomic<int> solved{0};
+    auto report = [&](int index, const BasicPath<W, H>& solution, uint64_t states, double secs) {
+        total_states += states;
+        std::lock_guard<std::mutex> lock(out_mutex);
+        std::cout << "board " << index << ": ";
+        if (!solution.empty()) {
+            solved++;
+            std::cout << solution.size() << " moves, " << states << " states, "
+                      << secs << " s: " << solution;
+        } else {
+            std::cout << "no solution, " << states << " states, "
+                      << secs << " s" << std::endl;
+        }
+    };
+    const bool one_by_one = opt.exact || opt.beam > 0 || opt.nrpa > 0 || !opt.portfolio.empty()
+                         || opt.budget_ms > 0 || opt.budget_states > 0;
+    int boards = 0;
+    const auto start_time = std::chrono::steady_clock::now();
+    std::string text;
+    for (int line_no = 1; std::getline(*in, text); line_no++) {
+        if (text.empty() || text[0] == '#') {
+            continue;
         }
-        os << '\n';
+        PackedBoard board;
+        if (!parse_board(text, board)) {
+            std::cerr << "Line " << line_no << ": expected " << W * H
+                      << " fallen squares of \"-RGBY\", skipped\n";
+            continue;
+        }
+        const int index = boards++;
+        if (one_by_one) {
+            // The search's progress report is not printed.
+            std::ostringstream log;
+            uint64_t states = 0;
+            const auto t0 = std::chrono::steady_clock::now();
+            const BasicPath<W, H> solution = solve<W, H>(board, opt, pool, tt, log, &states);
+            const std::chrono::duration<double> secs = std::chrono::steady_clock::now() - t0;
+            report(index, solution, states, secs.count());
+            continue;
+        }
+        pool.submit([&, board, index] {
+            Worker& w = *workers[pool.worker_index()];
+            const uint64_t states_before = w.search.states;
+            const auto t0 = std::chrono::steady_clock::now();
+            w.done = false;
+            w.search.reset();
+            w.search.search(Game(board), opt.policy.depth, opt.policy.width);
+            const std::chrono::duration<double> secs = std::chrono::steady_clock::now() - t0;
+            report(index, w.search.found ? complete(board, w.search.solution, opt.tablebase) : BasicPath<W, H>(),
+                   w.search.states - states_before, secs.count());
+        });
     }
-    return os;
+    pool.wait();
+    const std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start_time;
+    std::cout << boards << " boards (" << solved << " solved) in " << secs.count() << " s on "
+              << pool.size() << " threads: " << boards / secs.count() << " boards/s, "
+              << total_states / secs.count() << " states/s" << std::endl;
+    return 0;
 }
 
-std::ostream& operator<<(std::ostream& os, const std::stack<Coord, Move>& stack) {
-    std::stack<Coord, Move> tmp = stack;
-    while (tmp.size() > 0) {
-        os << tmp.top() << ",";
-        tmp.pop();
-    }
-    os << std::endl;
-    return os;
+// Solves board with the search opt asks for, printing progress and the
+// result to log. Returns the solution, empty if none was found, and sets
+// states, if given, to the states generated.
+template<int W, int H>
+static BasicPath<W, H> solve(const BasicPackedBoard<W, H>& board, const Options& opt,
+                             WorkStealingPool& pool, TranspositionTable& tt,
+                             std::ostream& log, uint64_t* states) {
+    typedef BasicPath<W, H> Path;
+    const BasicGame<W, H> game{board};
+    log << board << std::endl;
+    auto start_time = std::chrono::high_resolution_clock::now();
+    log << game.board.count_groups() << " possible moves in initial board" << std::endl;
+    if (opt.exact) {
+        BasicExactSearch<W, H> search(pool, tt, opt.tablebase);
+        search.progress = &log;
+        const int moves = search.search(game);
+        auto end_time = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> duration_s = end_time - start_time;
+        log << "Search took " << duration_s.count() << " s on " << pool.size() << " threads, and generated " << search.states() << " board states\n";
+        tt.print_stats(log, search.tt_stats());
+        log << "Optimal solution is " << moves << " moves: " << search.solution;
+        if (states) {
+            *states = search.states();
+        }
+        return search.solution;
+    }
+    if (opt.beam > 0) {
+        BasicBeamSearch<W, H> search(pool, opt.beam);
+        const Path solution = search.search(game);
+        std::chrono::duration<double> duration_s = std::chrono::high_resolution_clock::now() - start_time;
+        log << "Search took " << duration_s.count() << " s on " << pool.size() << " threads, and generated " << search.states() << " board states\n";
+        log << "Beam of " << opt.beam << " found " << solution.size() << " moves: " << solution;
+        if (states) {
+            *states = search.states();
+        }
+        return solution;
+    }
+    if (!opt.portfolio.empty()) {
+        BasicAnytime<W, H> anytime(game.board, opt.budget_ms / 1000, opt.budget_states, [&log](const Path& line, double secs) {
+            log << line.size() << " moves after " << secs << " s: " << line;
+        }, opt.tablebase);
+        BasicPortfolio<W, H> search(opt.threads, tt, anytime, opt.portfolio);
+        const Path best = search.run(game);
+        log << "Search took " << anytime.elapsed() << " s on " << search.threads() << " threads, and generated " << search.states() << " board states\n";
+        if (best.empty()) {
+            log << "No solution within the budget" << std::endl;
+        } else {
+            log << "Best solution is " << best.size() << " moves, from " << opt.portfolio[search.winner()].name()
+                << ": " << best;
+        }
+        if (states) {
+            *states = search.states();
+        }
+        return best;
+    }
+    if (opt.nrpa > 0) {
+        BasicAnytime<W, H> anytime(game.board, opt.budget_ms / 1000, opt.budget_states, [&log](const Path& line, double secs) {
+            log << line.size() << " moves after " << secs << " s: " << line;
+        }, opt.tablebase);
+        BasicRolloutSearch<W, H> search(pool, anytime, opt.nrpa);
+        const Path best = search.run(game);
+        log << "Search took " << anytime.elapsed() << " s on " << pool.size() << " threads, and generated " << search.states() << " board states\n";
+        log << "Best solution is " << best.size() << " moves: " << best;
+        if (states) {
+            *states = search.states();
+        }
+        return best;
+    }
+    if (opt.budget_ms > 0 || opt.budget_states > 0) {
+        BasicAnytime<W, H> anytime(game.board, opt.budget_ms / 1000, opt.budget_states, [&log](const Path& line, double secs) {
+            log << line.size() << " moves after " << secs << " s: " << line;
+        }, opt.tablebase);
+        BasicAnytimeSearch<W, H> search(pool, tt, anytime);
+        search.configure(opt.policy);
+        const Path best = search.run(game);
+        log << "Search took " << anytime.elapsed() << " s on " << pool.size() << " threads, and generated " << search.states() << " board states\n";
+        tt.print_stats(log, search.tt_stats());
+        if (best.empty()) {
+            log << "No solution within the budget" << std::endl;
+        } else {
+            log << "Best solution is " << best.size() << " moves: " << best;
+        }
+        if (states) {
+            *states = search.states();
+        }
+        return best;
+    }
+    BasicParallelSearch<W, H> search(pool, tt, 2, nullptr, opt.tablebase);
+    search.configure(opt.policy);
+    search.search(game, opt.policy.depth, opt.policy.width);
+    auto end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> duration_s = end_time - start_time;
+    log << "Search took " << duration_s.count() << " s on " << pool.size() << " threads, and generated " << search.states() << " board states\n";
+    tt.print_stats(log, search.tt_stats());
+    log << play(game.board, search.solution) << std::endl;
+    log << "Solution was: " << search.solution;
+    if (!opt.stats_file.empty()) {
+        if (!SearchStats::enabled) {
+            std::cerr << "Search statistics are compiled out, build with -DSEARCH_STATS\n";
+        }
+        if (opt.stats_file == "-") {
+            search.stats().print_json(log);
+        } else {
+            std::ofstream out(opt.stats_file);
+            search.stats().print_json(out);
+        }
+    }
+    if (states) {
+        *states = search.states();
+    }
+    return search.solution.empty() ? search.solution : complete(game.board, search.solution, opt.tablebase);
 }
 
-uint64_t calculated_states = 0;
-class Game{
-public:
-    Board board;
-    std::vector<Move> moves;
-    Coord origin;
-    Game() = delete;
-    Game(const Board& brd) : board(brd) {
-        calculated_states++;
-        moves.reserve(40);
-    };
-    Game(const Board& old, const Move& move) : board(old){
-        std::array<bool, HSIZE> verts_updated = {false};
-        origin = move[0];
-        calculated_states++;
-        moves.reserve(40);
-        for(Coord co : move) {
-            board[co.first][co.second] = 0;
-            verts_updated[co.first] = true;
+// Answers one request of the server: a board in the batch format, with
+// settings for that board only anywhere on the line, such as
+//   depth=N width=N budget-ms=N budget-states=N beam=K nrpa=L exact
+//   portfolio=default|STRATEGY,...
+// The answer is one line, like the results of --batch. A board one move
+// on from session's, or the same board, continues the session, so a line
+// found for the previous board is answered again without a search; any
+// other board starts a new one. Engines other than the greedy and anytime
+// searches solve from scratch.
+template<int W, int H>
+static std::string answer(const std::string& request, Options opt, WorkStealingPool& pool,
+                          TranspositionTable& tt, std::unique_ptr<BasicSession<W, H>>& session) {
+    std::istringstream words(request);
+    std::string text;
+    std::string word;
+    while (words >> word) {
+        const std::size_t eq = word.find('=');
+        if (eq == std::string::npos && word != "exact") {
+            text += word;
+            continue;
         }
-        for(int i = 0; i < verts_updated.size(); i++){
-            if(verts_updated[i]){
-                board[i].fall();
+        const std::string key = word.substr(0, eq);
+        const std::string value = eq == std::string::npos ? "" : word.substr(eq + 1);
+        try {
+            if (word == "exact") {
+                opt.exact = true;
+            } else if (key == "depth") {
+                opt.policy.depth = std::stoi(value);
+            } else if (key == "width") {
+                opt.policy.width = std::stoul(value);
+            } else if (key == "budget-ms") {
+                opt.budget_ms = std::stod(value);
+            } else if (key == "budget-states") {
+                opt.budget_states = std::stoull(value);
+            } else if (key == "beam") {
+                opt.beam = std::stoul(value);
+            } else if (key == "nrpa") {
+                opt.nrpa = std::stoi(value);
+            } else if (key == "portfolio") {
+                if (!parse_strategies(value == "default" ? DEFAULT_PORTFOLIO : value, opt.portfolio)) {
+                    return "error: bad strategy in " + word + "\n";
+                }
+            } else {
+                return "error: unknown setting " + word + "\n";
             }
+        } catch (const std::exception&) {
+            return "error: bad value in " + word + "\n";
         }
     }
+    const std::string bad_policy = opt.policy.check();
+    if (!bad_policy.empty()) {
+        return "error: " + bad_policy + "\n";
+    }
+    BasicPackedBoard<W, H> board;
+    if (!parse_board(text, board)) {
+        return "error: expected " + std::to_string(W * H) + " fallen squares of \"-RGBY\"\n";
+    }
 
-    bool has_co_in_moves(Coord co){
-        for(const Move& mv : moves){
-            if(std::find(mv.begin(), mv.end(), co) != mv.end()){
-                return true;
-            }
+    // The progress report of the search is not sent to the client.
+    std::ostringstream log;
+    uint64_t states = 0;
+    const auto t0 = std::chrono::steady_clock::now();
+    BasicPath<W, H> solution;
+    if (opt.exact || opt.beam > 0 || opt.nrpa > 0 || !opt.portfolio.empty()) {
+        solution = solve<W, H>(board, opt, pool, tt, log, &states);
+    } else {
+        if (!session || !(session->board() == board || session->advance(board))) {
+            session.reset(new BasicSession<W, H>(pool, tt, board, opt.tablebase));
         }
-        return false;
+        session->policy = opt.policy;
+        const uint64_t states_before = session->states();
+        solution = session->hint(opt.budget_ms / 1000, opt.budget_states);
+        states = session->states() - states_before;
     }
+    const std::chrono::duration<double> secs = std::chrono::steady_clock::now() - t0;
+    std::ostringstream out;
+    if (solution.empty() && board.occupied()) {
+        out << "no solution, " << states << " states, " << secs.count() << " s" << std::endl;
+    } else {
+        out << solution.size() << " moves, " << states << " states, " << secs.count() << " s: " << solution;
+    }
+    return out.str();
+}
 
-    void expand_move(Move& mv, const Coord co, const Square sq){
-        std::stack<Coord, Move> to_visit;
-        bool scratch[HSIZE][VSIZE] = {false};
-
-        to_visit.push(co);
-
-        while (!to_visit.empty()) {
-            Coord current = to_visit.top();
-            to_visit.pop();
-            scratch[current.first][current.second] = true;
-            mv.push_back(current);
+// Solver daemon: answers boards, one request per line, for clients on the
+// Unix domain socket at path, or on stdin and stdout if path is "-". The
+// workers, transposition table and tablebase are kept from request to
+// request, so related boards, like a game after each move, are solved
+// warm. Every search uses all the workers, so requests are solved one at
+// a time, in the order they come in.
+template<int W, int H>
+static int run_server(const std::string& path, Options opt) {
+    opt.stats_file.clear();
+    TranspositionTable tt(opt.tt_mb);
+    WorkStealingPool pool(opt.threads);
+    std::mutex solve_mutex;
+    // Each client plays its own game.
+    typedef std::unique_ptr<BasicSession<W, H>> Session;
+    auto reply = [&](const std::string& request, Session& session) {
+        std::lock_guard<std::mutex> lock(solve_mutex);
+        return answer<W, H>(request, opt, pool, tt, session);
+    };
 
-            Coord up(current.first, current.second - 1);
-            Coord down(current.first, current.second + 1);
-            Coord left(current.first - 1, current.second);
-            Coord right(current.first + 1, current.second);
-            if(up.second >= 0 && !scratch[up.first][up.second] && board.at(up) == sq){
-                to_visit.push(up);
+    if (path == "-") {
+        Session session;
+        std::string text;
+        while (std::getline(std::cin, text)) {
+            if (!text.empty() && text[0] != '#') {
+                std::cout << reply(text, session) << std::flush;
             }
-            if(down.second < VSIZE && !scratch[down.first][down.second] && board.at(down) == sq){
-                to_visit.push(down);
-            }
-            if(left.first >= 0 && !scratch[left.first][left.second] && board.at(left) == sq){
-                to_visit.push(left);
+        }
+        return 0;
+    }
+
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Socket path " << path << " is too long\n";
+        return 1;
+    }
+    std::strcpy(addr.sun_path, path.c_str());
+    // A socket left by an earlier server is replaced, anything else kept.
+    struct stat existing;
+    if (lstat(path.c_str(), &existing) == 0) {
+        if (!S_ISSOCK(existing.st_mode)) {
+            std::cerr << path << " exists and is not a socket\n";
+            return 1;
+        }
+        unlink(path.c_str());
+    }
+    const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0
+        || listen(listener, 16) != 0) {
+        std::cerr << "Failed to listen on " << path << ": " << std::strerror(errno) << "\n";
+        return 1;
+    }
+    std::cout << "Serving " << W << "x" << H << " boards on " << path << std::endl;
+    // Client threads use reply, and through it the pool and the table, so
+    // all of them are joined before those go away. Finished ones are
+    // joined at every new connection.
+    struct Client {
+        int socket;
+        std::thread thread;
+        std::atomic<bool> finished{false};
+    };
+    std::vector<std::unique_ptr<Client>> clients;
+    auto serve = [&reply](Client& c) {
+        Session session;
+        std::string pending;
+        char buf[4096];
+        ssize_t n;
+        bool connected = true;
+        while (connected && (n = recv(c.socket, buf, sizeof(buf), 0)) > 0) {
+            pending.append(buf, n);
+            std::size_t end;
+            while (connected && (end = pending.find('\n')) != std::string::npos) {
+                std::string text = pending.substr(0, end);
+                pending.erase(0, end + 1);
+                if (!text.empty() && text.back() == '\r') {
+                    text.pop_back();
+                }
+                if (text.empty() || text[0] == '#') {
+                    continue;
+                }
+                const std::string out = reply(text, session);
+                // A client that hung up must not take the server down
+                // with SIGPIPE.
+                connected = send(c.socket, out.data(), out.size(), MSG_NOSIGNAL) == ssize_t(out.size());
             }
-            if(right.first < HSIZE && !scratch[right.first][right.second] && board.at(right) == sq){
-                to_visit.push(right);
+        }
+        c.finished = true;
+    };
+    auto join = [](Client& c) {
+        c.thread.join();
+        close(c.socket);
+    };
+    for (;;) {
+        const int client = accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) {
+                continue;
             }
+            std::cerr << "accept: " << std::strerror(errno) << "\n";
+            break;
         }
+        clients.erase(std::remove_if(clients.begin(), clients.end(), [&join](const std::unique_ptr<Client>& c) {
+            if (c->finished) {
+                join(*c);
+            }
+            return c->finished.load();
+        }), clients.end());
+        clients.emplace_back(new Client);
+        Client& c = *clients.back();
+        c.socket = client;
+        c.thread = std::thread(serve, std::ref(c));
     }
+    // Clients still connected see their connection end after their
+    // current request.
+    for (const auto& c : clients) {
+        shutdown(c->socket, SHUT_RDWR);
+        join(*c);
+    }
+    close(listener);
+    return 1;
+}
 
-    // void expand_move(Move& mv, const Coord co, const Square sq){
-    //     mv.push_back(co);
-    //     Coord up(co.first, co.second - 1);
-    //     Coord down(co.first, co.second + 1);
-    //     Coord left(co.first - 1, co.second);
-    //     Coord right(co.first + 1, co.second);
-    //     if(up.second >= 0 && board.at(up) == sq && std::find(mv.begin(), mv.end(), up) == mv.end()){
-    //         expand_move(mv, up, sq);
-    //     }
-    //     if(down.second < VSIZE && board.at(down) == sq && std::find(mv.begin(), mv.end(), down) == mv.end()){
-    //         expand_move(mv, down, sq);
-    //     }
-    //     if(left.first >= 0 && board.at(left) == sq && std::find(mv.begin(), mv.end(), left) == mv.end()){
-    //         expand_move(mv, left, sq);
-    //     }
-    //     if(right.first < HSIZE && board.at(right) == sq && std::find(mv.begin(), mv.end(), right) == mv.end()){
-    //         expand_move(mv, right, sq);
-    //     }
-    // }
-
-    // void expand_move(Move& mv, std::array<std::array<bool, VSIZE>, HSIZE>& scratch,  const Coord co, const Square sq){
-    //     scratch[co.first][co.second] = true;
-    //     mv.push_back(co);
-    //     Coord up(co.first, co.second - 1);
-    //     Coord down(co.first, co.second + 1);
-    //     Coord left(co.first - 1, co.second);
-    //     Coord right(co.first + 1, co.second);
-    //     if(up.second >= 0 && board.at(up) == sq && !scratch[up.first][up.second]){
-    //         expand_move(mv, scratch, up, sq);
-    //     }
-    //     if(down.second < VSIZE && board.at(down) == sq && !scratch[down.first][down.second]){
-    //         expand_move(mv, scratch, down, sq);
-    //     }
-    //     if(left.first >= 0 && board.at(left) == sq && !scratch[left.first][left.second]){
-    //         expand_move(mv, scratch, left, sq);
-    //     }
-    //     if(right.first < HSIZE && board.at(right) == sq && !scratch[right.first][right.second]){
-    //         expand_move(mv, scratch, right, sq);
-    //     }
-    // }
+// The annotator's cells, row by row, as the solver's column major Board.
+template<int W, int H>
+static BasicBoard<W, H> board_from_cells(const std::array<uint8_t, W * H>& cells) {
+    BasicBoard<W, H> board{};
+    for (int x = 0; x < W; x++) {
+        for (int y = 0; y < H; y++) {
+            board[x][y] = cells[y * W + x];
+        }
+    }
+    return board;
+}
 
-    int calculate_moves(){
-        //std::array<std::array<bool, VSIZE>, HSIZE> scratch = {false};
-        for (int y = 0; y < VSIZE; y++) {
-            for (int x = 0; x < HSIZE; x++) {
-                Square sq = board[x][y];
-                Coord co(x,y);
-                if(sq && !has_co_in_moves(co)){
-                    Move mv;
-                    mv.reserve(20);
-                    expand_move(mv, co, sq);
-                    moves.push_back(mv);
-                }
+// The screenshot square each move of solution taps, as (row, col). A
+// move's cell is on the board of its moment, after the squares above the
+// groups removed before it have fallen, so every square is followed down
+// its column as PackedBoard::remove moves it.
+template<int W, int H>
+static std::vector<std::pair<int, int>> tapped_squares(const BasicBoard<W, H>& start,
+                                                       const BasicPath<W, H>& solution) {
+    typedef BasicPackedBoard<W, H> PackedBoard;
+    std::array<uint8_t, W * H> from; // screenshot bit of the square at each bit
+    for (int b = 0; b < W * H; b++) {
+        from[b] = b;
+    }
+    PackedBoard board(start);
+    std::vector<std::pair<int, int>> moves;
+    for (uint8_t cell : solution) {
+        const Coord co = PackedBoard::coord(from[cell]);
+        moves.emplace_back(co.second, co.first);
+        const Move mv = board.group_at(cell);
+        for (uint64_t mask = mv; mask; mask &= ~(1ull << (63 - __builtin_clzll(mask)))) {
+            const int b = 63 - __builtin_clzll(mask);
+            for (int above = b; above % H != H - 1; above++) {
+                from[above] = from[above + 1];
             }
         }
-        return moves.size();
+        board.remove(mv);
     }
+    return moves;
+}
 
-};
+// Screenshot to solution: the annotator classifies the image, which is
+// then solved and optionally rendered with the moves numbered. Prints the
+// time of every stage.
+template<int W, int H>
+static int run_image(const std::string& image, const Options& opt) {
+    typedef std::chrono::steady_clock Clock;
+    std::array<uint8_t, W * H> cells{};
+    Annotator::Params params;
+    params.rows = H;
+    params.cols = W;
+    params.fast = !opt.full_res;
+    const Annotator::CellGrid grid{cells.data(), W, 1};
+    Annotator::Timings timings;
+    try {
+        Annotator::analyzeImageInto(image, params, grid, &timings);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    const BasicBoard<W, H> board = board_from_cells<W, H>(cells);
 
-bool compare_games(const std::pair<int, Game>& lh, const std::pair<int, Game>& rh){
-    return lh.first < rh.first;
+    TranspositionTable tt(opt.tt_mb);
+    WorkStealingPool pool(opt.threads);
+    const auto t0 = Clock::now();
+    const BasicPath<W, H> solution = solve<W, H>(board, opt, pool, tt);
+    const std::chrono::duration<double, std::milli> solve_ms = Clock::now() - t0;
+
+    std::chrono::duration<double, std::milli> render_ms(0);
+    if (!opt.render_file.empty() && !solution.empty()) {
+        const auto t1 = Clock::now();
+        Annotator::renderSolution(image, params, grid, tapped_squares(board, solution), opt.render_file);
+        render_ms = Clock::now() - t1;
+    }
+    std::cout << "Pipeline: decode " << timings.decodeMs << " ms, classify " << timings.classifyMs << " ms";
+    if (params.fast) {
+        std::cout << ", full resolution for " << timings.fallbackCells << " cells " << timings.fallbackMs << " ms";
+    }
+    std::cout << ", solve " << solve_ms.count() << " ms";
+    if (!opt.render_file.empty()) {
+        std::cout << ", render " << render_ms.count() << " ms";
+    }
+    std::cout << std::endl;
+    return 0;
 }
 
-bool done = false;
-std::stack<Coord, Move> solution;
+// Follows a game on video: every time the board on screen changes it is
+// solved again, with the table and workers kept from board to board.
+template<int W, int H>
+static int run_stream(const std::string& source, const Options& opt) {
+    std::array<uint8_t, W * H> cells{};
+    Annotator::Params params;
+    params.rows = H;
+    params.cols = W;
+    params.fast = !opt.full_res;
+    const Annotator::CellGrid grid{cells.data(), W, 1};
+    std::unique_ptr<Annotator::BoardStream> stream;
+    try {
+        stream.reset(new Annotator::BoardStream(source, params));
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    TranspositionTable tt(opt.tt_mb);
+    WorkStealingPool pool(opt.threads);
+    Annotator::StreamStats stats;
+    while (stream->next(grid, &stats)) {
+        std::cout << "Frame " << stats.frames << ": new board" << std::endl;
+        solve<W, H>(board_from_cells<W, H>(cells), opt, pool, tt);
+    }
+    std::cout << stats.frames << " frames: " << stats.moving << " moving, " << stats.unchanged
+              << " unchanged, " << stats.classified << " classified, " << stats.boards << " boards, "
+              << stats.fallbackCells << " cells at full resolution; "
+              << (stats.frames ? stats.decodeMs / stats.frames : 0) << " ms decode per frame, "
+              << (stats.classified ? stats.classifyMs / stats.classified : 0) << " ms per classified frame"
+              << std::endl;
+    return 0;
+}
 
-class Search {
-public:
-    bool done = false;
-    std::stack<Coord, Move> solution;
-    void search(Game game, int depth, std::size_t width){
-        std::vector<std::pair<int, Game>> games;
-        if(depth-- == 0 || done){
-            return;
-        }
-        for(int i = 0; i < game.moves.size(); i++){
-            Game new_game(game.board, game.moves[i]);
-            games.push_back({new_game.calculate_moves(), new_game});
+static void usage(const char* program) {
+    std::cerr << "Usage: " << program << " [--tt-mb N] [--threads N] [--depth N] [--width N] [--policy FILE] [--exact] [--beam K] [--nrpa L] [--portfolio default|LIST] [--budget-ms N] [--budget-states N] [--stats FILE|-] [--size WxH] [--tablebase FILE] [--render FILE] [--full-res] <input_image>\n"
+              << "       " << program << " [options] [--size WxH] --batch <file|->\n"
+              << "       " << program << " [options] [--size WxH] --stream <video|camera index|frame pattern>\n"
+              << "       " << program << " [options] [--size WxH] --serve <socket|->\n"
+              << "       " << program << " [options] --reference NAME\n";
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    std::string input_image;
+    std::string batch;
+    std::string reference;
+    std::string stream;
+    std::string serve;
+    std::string tablebase_file;
+    int size_w = HSIZE;
+    int size_h = VSIZE;
+    // Numbers that do not parse end up in the catch below.
+    int i = 1;
+    try {
+        for (; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--tt-mb" && i + 1 < argc) {
+                opt.tt_mb = std::stoul(argv[++i]);
+            } else if (arg == "--threads" && i + 1 < argc) {
+                opt.threads = std::stoi(argv[++i]);
+            } else if (arg == "--exact") {
+                opt.exact = true;
+            } else if (arg == "--beam" && i + 1 < argc) {
+                opt.beam = std::stoul(argv[++i]);
+            } else if (arg == "--nrpa" && i + 1 < argc) {
+                opt.nrpa = std::stoi(argv[++i]);
+            } else if (arg == "--portfolio" && i + 1 < argc) {
+                const std::string members = argv[++i];
+                if (!parse_strategies(members == "default" ? DEFAULT_PORTFOLIO : members, opt.portfolio)) {
+                    std::cerr << "Bad portfolio " << members << ", expected greedy:DEPTH:WIDTH:PRUNE, beam:K"
+                              << " or nrpa:LEVEL separated by commas\n";
+                    return 1;
+                }
+            } else if (arg == "--batch" && i + 1 < argc) {
+                batch = argv[++i];
+            } else if (arg == "--serve" && i + 1 < argc) {
+                serve = argv[++i];
+            } else if (arg == "--stream" && i + 1 < argc) {
+                stream = argv[++i];
+            } else if (arg == "--reference" && i + 1 < argc) {
+                reference = argv[++i];
+            } else if (arg == "--depth" && i + 1 < argc) {
+                opt.policy.depth = std::stoi(argv[++i]);
+            } else if (arg == "--width" && i + 1 < argc) {
+                opt.policy.width = std::stoul(argv[++i]);
+            } else if (arg == "--budget-ms" && i + 1 < argc) {
+                opt.budget_ms = std::stod(argv[++i]);
+            } else if (arg == "--budget-states" && i + 1 < argc) {
+                opt.budget_states = std::stoull(argv[++i]);
+            } else if (arg == "--size" && i + 1 < argc) {
+                if (std::sscanf(argv[++i], "%dx%d", &size_w, &size_h) != 2) {
+                    size_w = size_h = 0;
+                }
+            } else if (arg == "--stats" && i + 1 < argc) {
+                opt.stats_file = argv[++i];
+            } else if (arg == "--render" && i + 1 < argc) {
+                opt.render_file = argv[++i];
+            } else if (arg == "--full-res") {
+                opt.full_res = true;
+            } else if (arg == "--policy" && i + 1 < argc) {
+                // Read in place, so --depth and --width after it still win.
+                const std::string file = argv[++i];
+                std::ifstream in(file);
+                std::string error;
+                if (!in) {
+                    std::cerr << "Failed to open " << file << "\n";
+                    return 1;
+                }
+                if (!opt.policy.read(in, error)) {
+                    std::cerr << file << ": bad line \"" << error << "\"\n";
+                    return 1;
+                }
+            } else if (arg == "--tablebase" && i + 1 < argc) {
+                tablebase_file = argv[++i];
+            } else {
+                input_image = arg;
+            }
         }
-        std::stable_sort(games.begin(), games.end(), compare_games);
-        if(width > 5){
-            width--;
+    } catch (const std::exception&) {
+        std::cerr << "Bad value for " << argv[i - 1] << ": " << argv[i] << "\n";
+        usage(argv[0]);
+        return 1;
+    }
+    if (opt.threads < 1) {
+        std::cerr << "--threads must be at least 1\n";
+        usage(argv[0]);
+        return 1;
+    }
+    if (opt.tt_mb < 1 || opt.tt_mb > TranspositionTable::MAX_MEGABYTES) {
+        std::cerr << "--tt-mb must be between 1 and " << TranspositionTable::MAX_MEGABYTES << "\n";
+        usage(argv[0]);
+        return 1;
+    }
+    const std::string bad_policy = opt.policy.check();
+    if (!bad_policy.empty()) {
+        std::cerr << bad_policy << "\n";
+        usage(argv[0]);
+        return 1;
+    }
+    // Reference boards are always HSIZE x VSIZE.
+    if (!reference.empty()) {
+        size_w = HSIZE;
+        size_h = VSIZE;
+    }
+    std::unique_ptr<Tablebase> tablebase;
+    if (!tablebase_file.empty()) {
+        try {
+            tablebase.reset(new Tablebase(tablebase_file, size_w, size_h));
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            return 1;
         }
-        for(int i = 0; i < std::min(width, games.size()); i++){
-            auto& pair = games[i];
-            if(pair.first <= 2){
-                done = true;
-                std::cout << pair.second.board << depth << std::endl << std::endl;
-            } else if (pair.first < (depth + 3)*3.6) {
-                search(pair.second, depth, width);
-            }
-            if (done) {
-                solution.push(pair.second.origin);
-                return;
+        opt.tablebase = tablebase.get();
+    }
+    if (!reference.empty()) {
+        for (const ReferenceBoard& ref : reference_boards()) {
+            if (reference == ref.name) {
+                std::cout << ref.note << "\n";
+                TranspositionTable tt(opt.tt_mb);
+                WorkStealingPool pool(opt.threads);
+                solve<HSIZE, VSIZE>(ref.board, opt, pool, tt);
+                return 0;
             }
         }
-        return;
+        std::cerr << "No reference board " << reference << "\n";
+        return 1;
     }
-};
-
-// void mt_search(Game game, int depth, std::size_t width, int threads){
-//     std::vector<std::pair<int, Game>> games;
-//     if(depth-- == 0 || done){
-//         return;
-//     }
-//     for(int i = 0; i < game.moves.size(); i++){
-//         Game new_game(game.board, game.moves[i]);
-//         games.push_back({new_game.calculate_moves(), new_game});
-//     }
-//     std::stable_sort(games.begin(), games.end(), compare_games);
-//     if(width > 5){
-//         width--;
-//     }
-//     for(int i = 0; i < std::min(width, games.size()); i++){
-//         auto& pair = games[i];
-//         if(pair.first <= 2){
-//             done = true;
-//             std::cout << pair.second.board << depth << std::endl << std::endl;
-//         } else if (pair.first < (depth + 3)*4) {
-//             search(pair.second, depth, width);
-//         }
-//         if (done) {
-//             solution.push(pair.second.origin);
-//             return;
-//         }
-//     }
-//     return;
-// }
-
-int main(int argc, char** argv) {
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <input_image>\n";
+    if (batch.empty() && stream.empty() && serve.empty() && input_image.empty()) {
+        usage(argv[0]);
         return 1;
     }
-    std::string input_image = argv[1];
-    auto newBoard = Annotator::analyzeBoard(input_image, Annotator::Params());
-    for (auto x : newBoard) {
-        for (auto y : x) {
-            std::cout << toLetter(y) << ' ';
+    int status = 1;
+    const bool known = with_board_size(size_w, size_h, [&](auto size) {
+        if (!batch.empty()) {
+            status = run_batch<size.width, size.height>(batch, opt);
+        } else if (!serve.empty()) {
+            status = run_server<size.width, size.height>(serve, opt);
+        } else if (!stream.empty()) {
+            status = run_stream<size.width, size.height>(stream, opt);
+        } else {
+            status = run_image<size.width, size.height>(input_image, opt);
         }
-        std::cout << '\n';
-    }
-    // Board board = {{ \ 
-    //     Vertical({Y, B, G, G, R, B, Y, G, G}), \
-    //     Vertical({B, B, G, G, Y, B, G, G, B}), \
-    //     Vertical({G, G, R, R, Y, B, G, B, G}), \
-    //     Vertical({Y, B, R, R, G, B, G, Y, B}), \
-    //     Vertical({G, B, R, B, G, G, B, B, Y}), \
-    //     Vertical({B, G, R, B, Y, B, R, Y, G}), \
-    //     Vertical({R, G, R, R, Y, R, Y, B, R}), \
-    // }}; // 15/8 beste 14
-    // Board board = {{ \ 
-    //     Vertical({G, B, G, R, Y, Y, R, G, R}), \
-    //     Vertical({Y, R, G, B, Y, B, R, Y, G}), \
-    //     Vertical({Y, B, B, R, G, R, Y, B, G}), \
-    //     Vertical({R, R, Y, R, B, Y, G, Y, B}), \
-    //     Vertical({G, R, G, Y, Y, Y, Y, Y, B}), \
-    //     Vertical({G, R, B, G, G, B, G, Y, B}), \
-    //     Vertical({R, Y, R, G, R, B, B, Y, Y}), \
-    // }}; // 18/8 beste 12
-    // Board board = {{ \
-    //     Vertical({R, G, Y, Y, B, G, B, R, G}), \
-    //     Vertical({G, B, R, R, R, Y, Y, R, G}), \
-    //     Vertical({B, G, Y, R, Y, R, Y, R, B}), \
-    //     Vertical({R, G, Y, B, R, G, R, B, G}), \
-    //     Vertical({G, G, B, B, Y, G, G, G, G}), \
-    //     Vertical({B, G, Y, R, R, B, G, Y, Y}), \
-    //     Vertical({R, B, G, Y, R, G, G, R, B}), \
-    // }};  // 20/8 beste 13
-    Board board = {{ \ 
-        Vertical({R, R, B, B, G, G, R, Y, G}), \
-        Vertical({G, B, G, R, Y, G, R, G, Y}), \
-        Vertical({G, R, G, Y, R, B, G, R, R}), \
-        Vertical({R, Y, G, R, R, Y, B, B, B}), \
-        Vertical({B, Y, Y, R, G, B, G, G, R}), \
-        Vertical({B, R, G, Y, Y, R, G, G, G}), \
-        Vertical({G, B, Y, R, B, R, R, Y, R}), \
-    }}; // 21/8 beste 14
-    Game game(board);
-    std::cout << "Hello" << std::endl;
-    std::cout << board << std::endl;
-    auto start_time = std::chrono::high_resolution_clock::now();
-    std::cout << game.calculate_moves() << " possible moves in initial board" << std::endl;
-    Search thread;
-    thread.search(game, 12, 12);
-    auto end_time = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double> duration_s = end_time - start_time;
-    std::cout << "Search took " << duration_s.count() << " s, and generated " << calculated_states << " board states\n";
-    std::cout << "Solution was: " << solution;
+    });
+    if (!known) {
+        std::cerr << "No solver for " << size_w << "x" << size_h << " boards, sizes are " << BOARD_SIZES << "\n";
+    }
+    return status;
 }
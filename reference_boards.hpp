@@ -0,0 +1,53 @@
+#pragma once
+#include <vector>
+#include "board.hpp"
+
+// Boards from past puzzles, kept with the note they were recorded with:
+// "<groups>/<colors> beste <best known solution>".
+struct ReferenceBoard {
+    const char* name;
+    const char* note;
+    Board board;
+};
+
+inline const std::vector<ReferenceBoard>& reference_boards() {
+    static const std::vector<ReferenceBoard> boards = {
+        {"15-8", "15/8 beste 14", {{
+            Vertical({Y, B, G, G, R, B, Y, G, G}),
+            Vertical({B, B, G, G, Y, B, G, G, B}),
+            Vertical({G, G, R, R, Y, B, G, B, G}),
+            Vertical({Y, B, R, R, G, B, G, Y, B}),
+            Vertical({G, B, R, B, G, G, B, B, Y}),
+            Vertical({B, G, R, B, Y, B, R, Y, G}),
+            Vertical({R, G, R, R, Y, R, Y, B, R}),
+        }}},
+        {"18-8", "18/8 beste 12", {{
+            Vertical({G, B, G, R, Y, Y, R, G, R}),
+            Vertical({Y, R, G, B, Y, B, R, Y, G}),
+            Vertical({Y, B, B, R, G, R, Y, B, G}),
+            Vertical({R, R, Y, R, B, Y, G, Y, B}),
+            Vertical({G, R, G, Y, Y, Y, Y, Y, B}),
+            Vertical({G, R, B, G, G, B, G, Y, B}),
+            Vertical({R, Y, R, G, R, B, B, Y, Y}),
+        }}},
+        {"20-8", "20/8 beste 13", {{
+            Vertical({R, G, Y, Y, B, G, B, R, G}),
+            Vertical({G, B, R, R, R, Y, Y, R, G}),
+            Vertical({B, G, Y, R, Y, R, Y, R, B}),
+            Vertical({R, G, Y, B, R, G, R, B, G}),
+            Vertical({G, G, B, B, Y, G, G, G, G}),
+            Vertical({B, G, Y, R, R, B, G, Y, Y}),
+            Vertical({R, B, G, Y, R, G, G, R, B}),
+        }}},
+        {"21-8", "21/8 beste 14", {{
+            Vertical({R, R, B, B, G, G, R, Y, G}),
+            Vertical({G, B, G, R, Y, G, R, G, Y}),
+            Vertical({G, R, G, Y, R, B, G, R, R}),
+            Vertical({R, Y, G, R, R, Y, B, B, B}),
+            Vertical({B, Y, Y, R, G, B, G, G, R}),
+            Vertical({B, R, G, Y, Y, R, G, G, G}),
+            Vertical({G, B, Y, R, B, R, R, Y, R}),
+        }}},
+    };
+    return boards;
+}
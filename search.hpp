@@ -0,0 +1,1605 @@
+#pragma once
+#include <stdint-gcc.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "board.hpp"
+#include "search_stats.hpp"
+#include "tablebase.hpp"
+#include "transposition.hpp"
+#include "thread_pool.hpp"
+
+// Everything here is a template on the board's width and height, with the
+// usual names (Game, Search, ...) for the HSIZE x VSIZE board at the end.
+
+// Moves from the root, each stored as the origin bit of its group.
+// Every move clears a square, so no line is longer than W * H.
+template<int W, int H>
+class BasicPath {
+public:
+    std::size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    uint8_t operator[](std::size_t i) const { return cells[i]; }
+    const uint8_t* begin() const { return cells.data(); }
+    const uint8_t* end() const { return cells.data() + length; }
+    void push_back(uint8_t cell) { cells[length++] = cell; }
+    void pop_back() { length--; }
+    void clear() { length = 0; }
+
+private:
+    std::array<uint8_t, W * H> cells;
+    uint8_t length = 0;
+};
+
+template<int W, int H>
+std::ostream& operator<<(std::ostream& os, const BasicPath<W, H>& path) {
+    for (uint8_t cell : path) {
+        os << BasicPackedBoard<W, H>::coord(cell) << ",";
+    }
+    os << std::endl;
+    return os;
+}
+
+template<int W, int H>
+class BasicGame{
+public:
+    typedef BasicPackedBoard<W, H> PackedBoard;
+    PackedBoard board;
+    uint64_t hash = 0;
+    Move move = 0;      // group removed from the parent to get here
+    uint8_t origin = 0; // move's origin bit
+    uint8_t score = 0;  // sort key among siblings, fewest first
+    BasicGame() = default;
+    BasicGame(const PackedBoard& brd) : board(brd), hash(brd.hash()) {};
+    BasicGame(const BasicGame& parent, const Move& mv) : board(parent.board), move(mv){
+        const uint64_t cols = PackedBoard::columns(move);
+        origin = PackedBoard::origin(move);
+        board.remove(move);
+        hash = parent.hash ^ parent.board.hash(cols) ^ board.hash(cols);
+    }
+
+    // Transposition table key, the same for the position and its mirror
+    // image, which have the same solutions and so the same lower bounds.
+    // The mirror hash is not kept up to date move by move: most children
+    // are never searched, so it is computed here, once for each node that
+    // is. A width limited search is not mirror invariant (sort_games breaks
+    // ties in scan order), so its entries are keyed by hash alone.
+    uint64_t key(uint64_t& mirror_hash) const {
+        mirror_hash = board.mirror_hash();
+        return std::min(hash, mirror_hash);
+    }
+
+    // True for a move on a symmetric board whose mirror image is a
+    // different group with a smaller mask. The two children are mirror
+    // images, so only the other one need be searched.
+    static bool mirror_skipped(bool symmetric, Move mv) {
+        return symmetric && PackedBoard::mirror(mv) < mv;
+    }
+
+    int calculate_moves(){
+        return board.count_groups();
+    }
+
+};
+
+// Stable insertion sort on score. Sibling lists are short, and
+// std::stable_sort would allocate a merge buffer for every node.
+template<class Game>
+void sort_games(Game* games, int count) {
+    for (int i = 1; i < count; i++) {
+        const Game game = games[i];
+        int j = i;
+        for (; j > 0 && games[j - 1].score > game.score; j--) {
+            games[j] = games[j - 1];
+        }
+        games[j] = game;
+    }
+}
+
+// Storage for the moves and children of every ply of one depth first
+// search. A ply's slice is overwritten each time that ply is expanded, so
+// a searcher allocates once and never frees during a search.
+template<int W, int H>
+class BasicNodeArena {
+public:
+    typedef BasicGame<W, H> Game;
+    static constexpr int PLIES = W * H;
+    BasicNodeArena() : moves(PLIES), games(PLIES * PLIES) {}
+    Groups& moves_at(std::size_t ply) { return moves[ply]; }
+    Game* games_at(std::size_t ply) { return &games[ply * PLIES]; }
+
+private:
+    std::vector<Groups> moves;
+    std::vector<Game> games;
+};
+
+// Plays path from start. Each move is the group holding its origin bit.
+template<int W, int H>
+BasicPackedBoard<W, H> play(BasicPackedBoard<W, H> board, const BasicPath<W, H>& path) {
+    for (uint8_t cell : path) {
+        board.remove(board.group_at(cell));
+    }
+    return board;
+}
+
+// Extends a Search line, which stops with at most two groups left, to one
+// that clears the board. Removing one of the last groups can split the
+// other, so the groups are cleared one at a time. Once few enough squares
+// are left for tablebase, it plays the rest optimally.
+template<int W, int H>
+BasicPath<W, H> complete(const BasicPackedBoard<W, H>& start, BasicPath<W, H> path,
+                         const Tablebase* tablebase = nullptr) {
+    BasicPackedBoard<W, H> board = play(start, path);
+    while (board.occupied()) {
+        Move mv = tablebase ? tablebase->best_move(board) : 0;
+        if (!mv) {
+            Groups moves;
+            board.groups(moves);
+            mv = moves[0];
+        }
+        path.push_back(BasicPackedBoard<W, H>::origin(mv));
+        board.remove(mv);
+    }
+    return path;
+}
+
+// Lines known to clear positions met by earlier searches, by position:
+// every position along a line that clears a board is cleared by the rest
+// of that line. A Search given one takes a child found here as solved if
+// the rest fits in the plies left, as it does with tablebase endings, so
+// a Session picks up from every position its searches have passed
+// through, not only from the one it started at. Only read while searches
+// run; lines are added between them.
+template<int W, int H>
+class BasicKnownLines {
+public:
+    typedef BasicPackedBoard<W, H> PackedBoard;
+    typedef BasicPath<W, H> Path;
+
+    // Records line, which clears start, for every position along it. A
+    // position keeps the shortest line it has been given.
+    void add(const PackedBoard& start, const Path& line) {
+        PackedBoard board = start;
+        for (std::size_t i = 0; i < line.size(); i++) {
+            Path rest;
+            for (std::size_t j = i; j < line.size(); j++) {
+                rest.push_back(line[j]);
+            }
+            Entry& e = entries[board.hash()];
+            // A different board with the same hash is replaced.
+            if (e.rest.empty() || !(e.board == board) || rest.size() < e.rest.size()) {
+                e.board = board;
+                e.rest = rest;
+            }
+            board.remove(board.group_at(line[i]));
+        }
+    }
+
+    // The shortest known line that clears board, null if none is.
+    const Path* find(const PackedBoard& board, uint64_t hash) const {
+        const auto it = entries.find(hash);
+        return it != entries.end() && it->second.board == board ? &it->second.rest : nullptr;
+    }
+
+    // Drops the positions with more than squares squares, which a game
+    // now at squares squares cannot reach again.
+    void drop_above(int squares) {
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (__builtin_popcountll(it->second.board.occupied()) > squares) {
+                it = entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    std::size_t size() const { return entries.size(); }
+
+private:
+    struct Entry {
+        PackedBoard board;
+        Path rest;
+    };
+    std::unordered_map<uint64_t, Entry> entries;
+};
+
+// Best solution found so far by the Searches of an anytime search, and the
+// budget they share. Such Searches do not stop at their first solution:
+// they keep looking for shorter ones until the budget runs out.
+template<int W, int H>
+class BasicAnytime {
+public:
+    typedef BasicPackedBoard<W, H> PackedBoard;
+    typedef BasicPath<W, H> Path;
+    typedef std::chrono::steady_clock Clock;
+    // Called with every improvement and the seconds since the start.
+    typedef std::function<void(const Path&, double)> Callback;
+
+    // A zero budget is no limit.
+    BasicAnytime(const PackedBoard& start, double seconds, uint64_t max_states, Callback cb = Callback(),
+                 const Tablebase* tb = nullptr)
+        : root(start), start_time(Clock::now()), limit(std::chrono::duration<double>(seconds)),
+          state_limit(max_states), on_improve(cb), endgames(tb) {}
+
+    const Tablebase* tablebase() const {
+        return endgames;
+    }
+
+    // Moves in the best solution so far, INT_MAX before the first.
+    int moves() const {
+        return best;
+    }
+
+    // Who offered the best solution so far, -1 if nobody said.
+    int source() const {
+        return best_source;
+    }
+
+    Path solution() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return best_line;
+    }
+
+    double elapsed() const {
+        return std::chrono::duration<double>(Clock::now() - start_time).count();
+    }
+
+    // Plies a Search at ply may still go and improve on the best solution.
+    int depth_left(std::size_t ply) const {
+        return best == INT_MAX ? W * H : best - 1 - int(ply);
+    }
+
+    // Offers a Search line ending with groups_left groups, or as many
+    // moves left if the tablebase knows them. by tells who found it.
+    void offer(const Path& line, int groups_left, int by = -1) {
+        if (int(line.size()) + groups_left >= best) {
+            return;
+        }
+        const Path full = complete(root, line, endgames);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (int(full.size()) < best) {
+            best_line = full;
+            best = full.size();
+            best_source = by;
+            if (on_improve) {
+                on_improve(full, elapsed());
+            }
+        }
+    }
+
+    // False if the budget is no limit.
+    bool bounded() const {
+        return state_limit || limit.count() > 0;
+    }
+
+    // Adds states to the shared count; true once the budget is spent.
+    bool spend(uint64_t new_states) {
+        const uint64_t total = states += new_states;
+        return stopped || (state_limit && total >= state_limit)
+            || (limit.count() > 0 && Clock::now() - start_time >= limit);
+    }
+
+    // Spends the rest of the budget at once: every search charging it
+    // stops at its next spend().
+    void stop() {
+        stopped = true;
+    }
+
+    // Tells this Anytime's searches apart from those of the others (15
+    // bits, so ids come around again after 32768 of them).
+    uint16_t run() const {
+        return run_id;
+    }
+
+private:
+    const PackedBoard root;
+    const Clock::time_point start_time;
+    const std::chrono::duration<double> limit;
+    const uint64_t state_limit;
+    Callback on_improve;
+    const Tablebase* endgames;
+    std::atomic<int> best{INT_MAX};
+    std::atomic<uint64_t> states{0};
+    std::atomic<bool> stopped{false};
+    std::atomic<int> best_source{-1};
+    std::mutex mutex;
+    Path best_line;
+    const uint16_t run_id = next_run();
+
+    static uint16_t next_run() {
+        static std::atomic<uint16_t> runs{0};
+        return runs++ & 0x7fff;
+    }
+};
+
+// Values one setting of SearchPolicy may take, and the narrower range the
+// tune tool searches. Listed in the order of SearchPolicy::Setting.
+struct PolicyRange {
+    const char* name;
+    double lowest;
+    double highest;
+    double min;
+    double max;
+    bool integer;
+};
+
+// Depth and width stop at 255, the most a transposition table entry holds.
+static constexpr PolicyRange POLICY_RANGES[] = {
+    {"depth", 1, 255, 4, 24, true},
+    {"width", 1, 255, 2, 24, true},
+    {"min_width", 1, 255, 1, 24, true}, // the tuner keeps it at most width
+    {"prune_offset", 0, 100, 0, 8, false},
+    {"prune", 0.1, 100, 2, 8, false},
+};
+
+// The depth first search's constants. A search starts with depth plies
+// and width children per node; the width drops by one per ply until it
+// reaches min_width, and children with (depth left + prune_offset) *
+// prune groups or more are not searched. The solver reads them from a
+// file written by the tune tool with --policy.
+struct SearchPolicy {
+    int depth = 12;
+    std::size_t width = 12;
+    std::size_t min_width = 5;
+    double prune_offset = 3;
+    double prune = 3.6;
+
+    // The settings as get and set number them, as in POLICY_RANGES.
+    enum Setting { DEPTH, WIDTH, MIN_WIDTH, PRUNE_OFFSET, PRUNE, SETTINGS };
+
+    // Reads "name = value" lines as write() writes them, skipping blank
+    // lines and lines starting with '#'; settings not given keep their
+    // values. False, with the offending line in error, on anything else,
+    // including values outside POLICY_RANGES' lowest..highest.
+    bool read(std::istream& in, std::string& error) {
+        std::string text;
+        while (std::getline(in, text)) {
+            std::istringstream line(text);
+            std::string name, eq;
+            if (!(line >> name) || name[0] == '#') {
+                continue;
+            }
+            double value = 0;
+            int i = 0;
+            while (i < SETTINGS && name != POLICY_RANGES[i].name) {
+                i++;
+            }
+            if (i == SETTINGS || !(line >> eq >> value) || eq != "=" || !allowed(i, value)) {
+                error = text;
+                return false;
+            }
+            set(i, value);
+        }
+        return true;
+    }
+
+    // True if setting i may take value: within lowest..highest, and a
+    // whole number if it is an integer.
+    static bool allowed(int i, double value) {
+        const PolicyRange& r = POLICY_RANGES[i];
+        return value >= r.lowest && value <= r.highest && (!r.integer || value == std::floor(value));
+    }
+
+    // Empty if every setting is allowed(), else what is not.
+    std::string check() const {
+        for (int i = 0; i < SETTINGS; i++) {
+            if (!allowed(i, get(i))) {
+                const PolicyRange& r = POLICY_RANGES[i];
+                std::ostringstream error;
+                error << r.name << " must be between " << r.lowest << " and " << r.highest;
+                return error.str();
+            }
+        }
+        return "";
+    }
+
+    // Tags the transposition table entries written under this policy, so a
+    // search only takes the failures of searches that pruned as it does,
+    // whatever --policy, the tuner or a server request set before it.
+    // (Depth and width are kept in the entry itself.)
+    uint16_t rule() const {
+        uint64_t state = std::llround(prune * 1e6);
+        state = splitmix64(state) ^ uint64_t(std::llround(prune_offset * 1e6));
+        state = splitmix64(state) ^ min_width;
+        return splitmix64(state) >> 48;
+    }
+
+    // Setting i as a number.
+    double get(int i) const {
+        switch (i) {
+        case DEPTH: return depth;
+        case WIDTH: return double(width);
+        case MIN_WIDTH: return double(min_width);
+        case PRUNE_OFFSET: return prune_offset;
+        default: return prune;
+        }
+    }
+
+    // Sets setting i, rounded if it is an integer.
+    void set(int i, double value) {
+        switch (i) {
+        case DEPTH: depth = int(std::lround(value)); break;
+        case WIDTH: width = std::size_t(std::lround(value)); break;
+        case MIN_WIDTH: min_width = std::size_t(std::lround(value)); break;
+        case PRUNE_OFFSET: prune_offset = value; break;
+        default: prune = value; break;
+        }
+    }
+
+    void write(std::ostream& out) const {
+        out << "depth = " << depth << "\nwidth = " << width << "\nmin_width = " << min_width
+            << "\nprune_offset = " << prune_offset << "\nprune = " << prune << "\n";
+    }
+};
+static_assert(sizeof(POLICY_RANGES) / sizeof(POLICY_RANGES[0]) == SearchPolicy::SETTINGS,
+              "one range per setting");
+
+template<int W, int H>
+class BasicSearch {
+public:
+    typedef BasicGame<W, H> Game;
+    typedef BasicPath<W, H> Path;
+    typedef BasicAnytime<W, H> Anytime;
+    typedef BasicKnownLines<W, H> KnownLines;
+
+    // Shared by every Search working on the same board; the first one to
+    // claim it owns the solution and all others stop.
+    std::atomic<bool>& done;
+    TranspositionTable& tt;
+    bool found = false;
+    Path line;      // moves from the root to the game being searched
+    Path solution;
+    uint64_t states = 0;
+    TTStats tt_stats;
+    SearchStats stats;
+    // Set by ParallelSearch: games fewer than split_plies from the root are
+    // handed to spawn instead of being searched in place.
+    std::function<void(const Game&, int, std::size_t, const Path&)> spawn;
+    std::size_t split_plies = 0;
+    // Set for an anytime search: solutions go to it and, if it has a
+    // budget, only shorter ones are looked for afterwards; done is set when
+    // the budget runs out, or at the first solution if there is none.
+    Anytime* anytime = nullptr;
+    // If set, children it can clear within the plies left are solutions,
+    // with the exact number of moves that takes.
+    const Tablebase* tablebase = nullptr;
+    // If set, so are children it knows a line for within the plies left.
+    const KnownLines* known_lines = nullptr;
+    // Pruning and width schedule; depth and width are search()'s.
+    SearchPolicy policy;
+    // Passed to anytime with every solution.
+    int source = -1;
+
+    BasicSearch(TranspositionTable& table, std::atomic<bool>& flag) : done(flag), tt(table) {}
+
+    // Forgets the previous board's solution; counters keep running.
+    void reset() {
+        found = false;
+        line.clear();
+        solution.clear();
+    }
+
+    void search(const Game& game, int depth, std::size_t width){
+        // Under an anytime search a position also counts as failed once it
+        // holds nothing shorter than the best solution so far, which only
+        // holds for that run: its entries are tagged for it alone.
+        rule = anytime ? uint16_t((policy.rule() ^ anytime->run()) | 0x8000) : uint16_t(policy.rule() & 0x7fff);
+        search(game, depth, width, nullptr);
+    }
+
+private:
+    BasicNodeArena<W, H> arena;
+    uint64_t spent = 0; // states already charged to anytime's budget
+    uint16_t rule = 0;  // of policy and anytime, for the transposition table
+
+    // parent_moves, if known, are the groups of game's parent, from which
+    // game's own groups are derived incrementally.
+    void search(const Game& game, int depth, std::size_t width, const Groups* parent_moves){
+        const std::size_t ply = line.size();
+        if(anytime){
+            depth = std::min(depth, anytime->depth_left(ply));
+            if(states - spent >= 1024){
+                if(anytime->spend(states - spent)){
+                    done = true;
+                }
+                spent = states;
+            }
+        }
+        if(depth <= 0){
+            stats.horizon(ply);
+            return;
+        }
+        if(done){
+            return;
+        }
+        // Keyed by hash alone, see Game::key().
+        if(tt.probe(game.hash, depth, width, rule, tt_stats)){
+            stats.tt_cutoff(ply);
+            return;
+        }
+        SearchStats::Scope scope(stats);
+        SearchStats::Timer timer = stats.start();
+        const int searched_depth = depth--;
+        const std::size_t searched_width = width;
+        const bool split = ply < split_plies;
+        Groups& moves = arena.moves_at(ply);
+        Game* games = arena.games_at(ply);
+        if(parent_moves){
+            game.board.groups_after(*parent_moves, game.move, moves);
+        } else {
+            game.board.groups(moves);
+        }
+        const bool symmetric = game.board.symmetric();
+        std::size_t count = 0;
+        for(const Move& mv : moves){
+            if(Game::mirror_skipped(symmetric, mv)){
+                continue;
+            }
+            games[count] = Game(game, mv);
+            games[count].score = games[count].board.count_groups_after(moves, mv);
+            states++;
+            count++;
+        }
+        stats.expand(ply, count);
+        stats.stop(SearchStats::MOVEGEN, timer);
+        sort_games(games, count);
+        stats.stop(SearchStats::SORT, timer);
+        if(width > policy.min_width){
+            width--;
+        }
+        for(std::size_t i = 0; i < std::min(width, count); i++){
+            const Game& child = games[i];
+            stats.visit(ply);
+            line.push_back(child.origin);
+            // A tablebase ending is only taken if it fits in the plies left;
+            // a longer one would end the search on a worse line.
+            const int endgame = tablebase ? tablebase->probe(child.board, child.hash) : -1;
+            const bool ends = child.score <= 2 || (endgame >= 0 && endgame <= depth);
+            const Path* known = known_lines && !ends ? known_lines->find(child.board, child.hash) : nullptr;
+            if(known && int(known->size()) > depth){
+                known = nullptr;
+            }
+            if(ends || known){
+                stats.solution(ply);
+                Path full = line;
+                if(known){
+                    for(const uint8_t cell : *known){
+                        full.push_back(cell);
+                    }
+                }
+                bool expected = false;
+                if(anytime){
+                    anytime->offer(full, known ? 0 : endgame >= 0 ? endgame : child.score, source);
+                    if(!anytime->bounded()){
+                        found = true;
+                        solution = full;
+                        done = true;
+                    }
+                } else if(done.compare_exchange_strong(expected, true)){
+                    found = true;
+                    solution = full;
+                }
+            } else if (child.score < (depth + policy.prune_offset)*policy.prune) {
+                if(split){
+                    spawn(child, depth, width, line);
+                } else {
+                    search(child, depth, width, &moves);
+                }
+            } else {
+                stats.prune(ply);
+            }
+            line.pop_back();
+            if (done) {
+                return;
+            }
+        }
+        if(!split){
+            tt.store(game.hash, searched_depth, searched_width, rule, tt_stats);
+        }
+        return;
+    }
+};
+
+// Runs Search on a work-stealing pool. The top split_plies of the tree are
+// turned into tasks, below that each task searches its subtree serially
+// with the Search owned by the worker running it.
+template<int W, int H>
+class BasicParallelSearch {
+public:
+    typedef BasicGame<W, H> Game;
+    typedef BasicPath<W, H> Path;
+    typedef BasicAnytime<W, H> Anytime;
+    typedef BasicSearch<W, H> Search;
+    typedef BasicKnownLines<W, H> KnownLines;
+
+    std::atomic<bool> done{false};
+    Path solution;
+
+    BasicParallelSearch(WorkStealingPool& workers, TranspositionTable& table, std::size_t plies,
+                        Anytime* anytime = nullptr, const Tablebase* tablebase = nullptr,
+                        const KnownLines* known_lines = nullptr)
+        : pool(workers), tt(table), split_plies(workers.size() > 1 ? plies : 0) {
+        searchers.reserve(pool.size());
+        for (int i = 0; i < pool.size(); i++) {
+            searchers.emplace_back(new Search(tt, done));
+            searchers.back()->split_plies = split_plies;
+            searchers.back()->anytime = anytime;
+            searchers.back()->tablebase = tablebase;
+            searchers.back()->known_lines = known_lines;
+            searchers.back()->spawn = [this](const Game& game, int depth, std::size_t width, const Path& line) {
+                pool.submit([this, game, depth, width, line] { run(game, depth, width, line); });
+            };
+        }
+    }
+
+    // Sets Search::policy and Search::source of every worker.
+    void configure(const SearchPolicy& policy, int source = -1) {
+        for (const auto& s : searchers) {
+            s->policy = policy;
+            s->source = source;
+        }
+    }
+
+    void search(const Game& game, int depth, std::size_t width) {
+        tt.new_generation();
+        pool.submit([this, game, depth, width] { run(game, depth, width, Path()); });
+        pool.wait();
+        for (const auto& s : searchers) {
+            if (s->found) {
+                solution = s->solution;
+            }
+        }
+    }
+
+    uint64_t states() const {
+        uint64_t total = 0;
+        for (const auto& s : searchers) {
+            total += s->states;
+        }
+        return total;
+    }
+
+    TTStats tt_stats() const {
+        TTStats total;
+        for (const auto& s : searchers) {
+            total += s->tt_stats;
+        }
+        return total;
+    }
+
+    SearchStats stats() const {
+        SearchStats total;
+        for (const auto& s : searchers) {
+            total += s->stats;
+        }
+        return total;
+    }
+
+private:
+    WorkStealingPool& pool;
+    TranspositionTable& tt;
+    std::size_t split_plies;
+    std::vector<std::unique_ptr<Search>> searchers;
+
+    void run(const Game& game, int depth, std::size_t width, const Path& line) {
+        Search& s = *searchers[pool.worker_index()];
+        s.line = line;
+        s.search(game, depth, width);
+    }
+};
+
+// Iterative deepening A*: proves the minimal number of moves that clears
+// the board. Each iteration searches every line whose length plus
+// PackedBoard::min_moves() stays within the threshold, and a failed
+// iteration leaves the raised lower bounds it found in the transposition
+// table for the next one. The root's children are searched in parallel.
+// With a tablebase, positions it holds are leaves of known exact cost.
+template<int W, int H>
+class BasicExactSearch {
+public:
+    typedef BasicGame<W, H> Game;
+    typedef BasicPath<W, H> Path;
+    typedef BasicPackedBoard<W, H> PackedBoard;
+
+    std::atomic<bool> done{false};
+    Path solution;
+    // Where every failed iteration is reported, nullptr for nowhere.
+    std::ostream* progress = &std::cout;
+
+    BasicExactSearch(WorkStealingPool& workers, TranspositionTable& table,
+                     const Tablebase* endgames = nullptr)
+        : pool(workers), tt(table), tablebase(endgames), searchers(workers.size()) {}
+
+    // Returns the optimal number of moves; solution holds one optimal line.
+    int search(const Game& root) {
+        Groups moves;
+        root.board.groups(moves);
+        const bool symmetric = root.board.symmetric();
+        tt.new_generation();
+        int bound = root.board.min_moves();
+        while (bound > 0 && !done) {
+            std::atomic<int> next{INT_MAX};
+            for (const Move& mv : moves) {
+                if (Game::mirror_skipped(symmetric, mv)) {
+                    continue;
+                }
+                pool.submit([this, &root, mv, bound, &next] {
+                    Searcher& s = searchers[pool.worker_index()];
+                    Game child(root, mv);
+                    s.states++;
+                    s.line.clear();
+                    s.line.push_back(child.origin);
+                    const int f = dfs(s, child, 1, bound);
+                    int cur = next;
+                    while (f < cur && !next.compare_exchange_weak(cur, f)) {}
+                });
+            }
+            pool.wait();
+            if (!done && progress) {
+                *progress << "No solution in " << bound << " moves (" << states() << " states)" << std::endl;
+            }
+            bound = next;
+        }
+        for (const Searcher& s : searchers) {
+            if (s.found) {
+                solution = complete(root.board, s.solution, tablebase);
+            }
+        }
+        return solution.size();
+    }
+
+    uint64_t states() const {
+        uint64_t total = 0;
+        for (const Searcher& s : searchers) {
+            total += s.states;
+        }
+        return total;
+    }
+
+    TTStats tt_stats() const {
+        TTStats total;
+        for (const Searcher& s : searchers) {
+            total += s.tt_stats;
+        }
+        return total;
+    }
+
+private:
+    static constexpr int FOUND = -1;
+
+    struct Searcher {
+        bool found = false;
+        Path line;
+        Path solution;
+        uint64_t states = 0;
+        TTStats tt_stats;
+        BasicNodeArena<W, H> arena;
+    };
+
+    WorkStealingPool& pool;
+    TranspositionTable& tt;
+    const Tablebase* tablebase;
+    std::vector<Searcher> searchers;
+
+    // Moves whose columns are at least two apart commute: neither changes
+    // the other's group. Of the two orders only the one with the smaller
+    // mask first is searched.
+    static bool commutes_before(Move mv, Move prev) {
+        const uint64_t cols = PackedBoard::columns(prev);
+        const uint64_t near = cols | (cols << H) | (cols >> H);
+        return !(mv & near) && mv < prev;
+    }
+
+    // Returns FOUND, or the smallest g + h past bound seen below game.
+    int dfs(Searcher& s, const Game& game, int g, int bound) {
+        if (done) {
+            return INT_MAX;
+        }
+        uint64_t mirror_hash;
+        const uint64_t key = game.key(mirror_hash);
+        const int exact = tablebase ? tablebase->probe(game.board, game.hash) : -1;
+        const int h = exact >= 0 ? exact : std::max(game.board.min_moves(), tt.probe_bound(key, s.tt_stats));
+        if (g + h > bound) {
+            return g + h;
+        }
+        if (h == 0 || exact >= 0) {
+            bool expected = false;
+            if (done.compare_exchange_strong(expected, true)) {
+                s.found = true;
+                s.solution = s.line;
+            }
+            return FOUND;
+        }
+        Groups& moves = s.arena.moves_at(g);
+        Game* games = s.arena.games_at(g);
+        int count = 0;
+        int skipped = INT_MAX;
+        game.board.groups(moves);
+        const bool symmetric = game.hash == mirror_hash && game.board.symmetric();
+        for (const Move& mv : moves) {
+            if (Game::mirror_skipped(symmetric, mv)) {
+                continue;
+            }
+            Game& child = games[count];
+            child = Game(game, mv);
+            child.score = child.board.min_moves();
+            s.states++;
+            if (commutes_before(mv, game.move)) {
+                skipped = std::min(skipped, 1 + child.score);
+                continue;
+            }
+            count++;
+        }
+        sort_games(games, count);
+        int next = INT_MAX;
+        for (int i = 0; i < count; i++) {
+            s.line.push_back(games[i].origin);
+            const int f = dfs(s, games[i], g + 1, bound);
+            s.line.pop_back();
+            if (f == FOUND) {
+                return FOUND;
+            }
+            next = std::min(next, f);
+        }
+        // The skipped moves are searched in another order elsewhere, so they
+        // need not raise the next threshold, but the stored bound is for the
+        // position whatever the move that led to it, and has to cover them.
+        // Moves skipped as mirror images are covered by their twins.
+        if (!done) {
+            tt.store_bound(key, std::min(next - g, skipped), s.tt_stats);
+        }
+        return next;
+    }
+};
+
+// Greedy searches of growing width under a time or state budget, each
+// bounded by the best solution so far: width 1 answers almost at once and
+// every wider pass can only improve on it. Ends when the budget is spent,
+// when the width covers every move, or when the solution meets the
+// PackedBoard::min_moves() lower bound and so is optimal.
+template<int W, int H>
+class BasicAnytimeSearch {
+public:
+    typedef BasicGame<W, H> Game;
+    typedef BasicPath<W, H> Path;
+    typedef BasicAnytime<W, H> Anytime;
+
+    BasicAnytimeSearch(WorkStealingPool& workers, TranspositionTable& table, Anytime& best,
+                       const BasicKnownLines<W, H>* known_lines = nullptr)
+        : anytime(best), search(workers, table, 2, &best, best.tablebase(), known_lines) {}
+
+    // Pruning and width schedule of the passes; their depth and width are
+    // the anytime search's own.
+    void configure(const SearchPolicy& policy) {
+        search.configure(policy);
+    }
+
+    // Returns the best solution found, empty if none was.
+    Path run(const Game& root) {
+        const int lower = root.board.min_moves();
+        for (std::size_t width = 1; width <= W * H && !search.done; width++) {
+            search.search(root, W * H, width);
+            if (anytime.moves() <= lower) {
+                break;
+            }
+        }
+        return anytime.solution();
+    }
+
+    uint64_t states() const { return search.states(); }
+    TTStats tt_stats() const { return search.tt_stats(); }
+    SearchStats stats() const { return search.stats(); }
+
+private:
+    Anytime& anytime;
+    BasicParallelSearch<W, H> search;
+};
+
+// Level synchronous beam search: expands every position of the frontier
+// by one move, scores the children, drops those reached twice and keeps
+// the best beam_width as the next frontier. Positions are compared across
+// the whole layer rather than among siblings, memory is bounded by the
+// beam width, and each layer is split between the pool's workers. The
+// first layer holding a cleared board gives the solution.
+template<int W, int H>
+class BasicBeamSearch {
+public:
+    typedef BasicGame<W, H> Game;
+    typedef BasicPath<W, H> Path;
+    typedef BasicPackedBoard<W, H> PackedBoard;
+    // Cost of a position to the beam, lower is better. groups is its
+    // count_groups(), which the beam has at hand.
+    typedef int (*Evaluation)(const PackedBoard& board, int groups);
+
+    // The moves left, as Search sorts siblings.
+    static int groups_left(const PackedBoard&, int groups) {
+        return groups;
+    }
+
+    // Moves left, plus the lower bound on the moves still needed: among
+    // positions with as many groups, prefers those whose colors are not
+    // split into many separate runs of columns.
+    static int groups_and_bound(const PackedBoard& board, int groups) {
+        return groups + board.min_moves();
+    }
+
+    // If set, every layer's states are charged to its budget, and the
+    // search gives up with an empty line once it is spent.
+    BasicAnytime<W, H>* anytime = nullptr;
+
+    BasicBeamSearch(WorkStealingPool& workers, std::size_t beam_width, Evaluation eval = groups_and_bound)
+        : pool(workers), width(std::max<std::size_t>(1, beam_width)), evaluate(eval),
+          buffers(workers.size()), counts(workers.size()) {}
+
+    // Returns a line that clears the board, empty for an empty board.
+    Path search(const Game& root) {
+        std::vector<Node> frontier(1, Node{root, 0, 0});
+        std::vector<std::vector<Step>> layers;
+        while (!frontier.empty() && frontier[0].game.board.occupied()) {
+            const uint64_t before = states();
+            expand(frontier);
+            if (anytime && anytime->spend(states() - before)) {
+                return Path();
+            }
+            std::vector<Node> next = select();
+            layers.emplace_back(next.size());
+            for (std::size_t i = 0; i < next.size(); i++) {
+                layers.back()[i] = Step{next[i].parent, next[i].game.origin};
+            }
+            frontier.swap(next);
+        }
+        Path reversed;
+        for (std::size_t ply = layers.size(), i = 0; ply-- > 0;) {
+            reversed.push_back(layers[ply][i].origin);
+            i = layers[ply][i].parent;
+        }
+        Path line;
+        for (std::size_t i = reversed.size(); i-- > 0;) {
+            line.push_back(reversed[i]);
+        }
+        return line;
+    }
+
+    uint64_t states() const {
+        uint64_t total = 0;
+        for (const uint64_t n : counts) {
+            total += n;
+        }
+        return total;
+    }
+
+private:
+    struct Node {
+        Game game;
+        uint32_t parent; // index in the frontier it was expanded from
+        int score;
+
+        // Best first, ties broken by position and then by parent so that
+        // the beam is the same whatever the number of workers.
+        bool operator<(const Node& rh) const {
+            if (score != rh.score) {
+                return score < rh.score;
+            }
+            if (game.hash != rh.game.hash) {
+                return game.hash < rh.game.hash;
+            }
+            return parent < rh.parent;
+        }
+    };
+
+    // Way back from a frontier position to the one it was expanded from.
+    struct Step {
+        uint32_t parent;
+        uint8_t origin;
+    };
+
+    WorkStealingPool& pool;
+    const std::size_t width;
+    const Evaluation evaluate;
+    std::vector<std::vector<Node>> buffers; // children generated by each worker
+    std::vector<uint64_t> counts;
+
+    // Expands frontier into the workers' buffers, a slice per task. Each
+    // buffer is cut back to its best width children whenever it doubles,
+    // which never drops one of the layer's best width.
+    void expand(const std::vector<Node>& frontier) {
+        for (auto& buffer : buffers) {
+            buffer.clear();
+        }
+        const std::size_t tasks = std::min<std::size_t>(frontier.size(), pool.size() * 4);
+        for (std::size_t t = 0; t < tasks; t++) {
+            pool.submit([this, &frontier, t, tasks] {
+                const int worker = pool.worker_index();
+                std::vector<Node>& buffer = buffers[worker];
+                Groups moves;
+                for (std::size_t i = t; i < frontier.size(); i += tasks) {
+                    const Game& game = frontier[i].game;
+                    game.board.groups(moves);
+                    for (const Move& mv : moves) {
+                        Node child{Game(game, mv), uint32_t(i), 0};
+                        child.score = evaluate(child.game.board, child.game.board.count_groups_after(moves, mv));
+                        buffer.push_back(child);
+                    }
+                    counts[worker] += moves.size();
+                    if (buffer.size() >= 2 * width) {
+                        trim(buffer);
+                    }
+                }
+            });
+        }
+        pool.wait();
+    }
+
+    // Keeps the best width distinct positions of buffer, in order.
+    void trim(std::vector<Node>& buffer) const {
+        std::sort(buffer.begin(), buffer.end(), [](const Node& a, const Node& b) {
+            return a.game.hash != b.game.hash ? a.game.hash < b.game.hash : a < b;
+        });
+        buffer.erase(std::unique(buffer.begin(), buffer.end(), [](const Node& a, const Node& b) {
+            return a.game.hash == b.game.hash;
+        }), buffer.end());
+        if (buffer.size() > width) {
+            std::nth_element(buffer.begin(), buffer.begin() + width, buffer.end());
+            buffer.resize(width);
+        }
+        std::sort(buffer.begin(), buffer.end());
+    }
+
+    // The next frontier: the best width distinct children of the layer.
+    std::vector<Node> select() {
+        std::vector<Node> all;
+        for (const auto& buffer : buffers) {
+            all.insert(all.end(), buffer.begin(), buffer.end());
+        }
+        trim(all);
+        // A cleared board ends the search; put it first.
+        for (std::size_t i = 0; i < all.size(); i++) {
+            if (!all[i].game.board.occupied()) {
+                std::swap(all[0], all[i]);
+                break;
+            }
+        }
+        return all;
+    }
+};
+
+// Nested rollout policy adaptation: random playouts to the end of the
+// game, with each move drawn in proportion to exp(policy weight of the
+// move). A search of level L runs iterations searches of level L - 1, each
+// from a copy of its policy, and after each one moves its own policy
+// towards the best line so far; level 0 is one playout. Moves are told
+// apart by their group and color, hashed into a table of weights, so what
+// is learned about a move carries over to the positions where the same
+// group is still on the board. Every worker runs its own searches, with
+// its own generator and policies, restarting from a blank policy until
+// the budget of the Anytime is spent (once each if it has none), and
+// offers every improvement to the Anytime.
+template<int W, int H>
+class BasicRolloutSearch {
+public:
+    typedef BasicGame<W, H> Game;
+    typedef BasicPath<W, H> Path;
+    typedef BasicPackedBoard<W, H> PackedBoard;
+    typedef BasicAnytime<W, H> Anytime;
+    static constexpr int POLICY_BITS = 16;
+    static constexpr float ALPHA = 1.0f; // step of a policy update
+    // Prior added to the weight of a move per square it clears, so that
+    // blank policies already lean towards big groups.
+    static constexpr float BIAS = 0.3f;
+    // Passed to the Anytime with every solution.
+    int source = -1;
+
+    BasicRolloutSearch(WorkStealingPool& workers, Anytime& best, int level = 3, int iterations = 100,
+                       uint64_t seed = 1)
+        : pool(workers), anytime(best), levels(std::max(1, level)), iterations(std::max(1, iterations)) {
+        for (int i = 0; i < workers.size(); i++) {
+            this->workers.emplace_back(new Worker(levels, seed + i));
+        }
+    }
+
+    // Returns the best solution found, empty for an empty board.
+    Path run(const Game& root) {
+        done = false;
+        lower = root.board.min_moves();
+        const bool restart = anytime.bounded();
+        for (int i = 0; i < pool.size(); i++) {
+            pool.submit([this, &root, restart] {
+                Worker& w = *workers[pool.worker_index()];
+                bool first = true;
+                while (!done && (first || restart)) {
+                    std::fill(w.policies[levels].begin(), w.policies[levels].end(), 0.0f);
+                    nrpa(w, root.board, levels);
+                    first = false;
+                }
+                spend(w, 0);
+            });
+        }
+        pool.wait();
+        return anytime.solution();
+    }
+
+    uint64_t states() const {
+        uint64_t total = 0;
+        for (const auto& w : workers) {
+            total += w->states;
+        }
+        return total;
+    }
+
+private:
+    struct Worker {
+        std::mt19937_64 rng;
+        std::vector<std::vector<float>> policies; // one per level
+        std::vector<Path> lines;                  // best line of each level
+        std::vector<std::pair<uint32_t, float>> updates;
+        uint64_t states = 0;
+        uint64_t unspent = 0; // states not yet added to the Anytime
+
+        Worker(int levels, uint64_t seed)
+            : rng(seed), policies(levels + 1, std::vector<float>(std::size_t(1) << POLICY_BITS)),
+              lines(levels + 1) {}
+    };
+
+    WorkStealingPool& pool;
+    Anytime& anytime;
+    const int levels;
+    const int iterations;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<bool> done{false};
+    int lower = 0;
+
+    // Index in the policy of removing group mv from board.
+    static uint32_t code(const PackedBoard& board, Move mv) {
+        int color = 0;
+        while (!(board.planes[color] & mv)) {
+            color++;
+        }
+        uint64_t state = mv ^ (uint64_t(color + 1) * 0x9e3779b97f4a7c15ull);
+        return splitmix64(state) >> (64 - POLICY_BITS);
+    }
+
+    // Fills weights with exp(policy weight plus prior) of every move,
+    // shifted by the largest so that none overflows, and returns their sum.
+    static float weigh(const PackedBoard& board, const Groups& moves, const std::vector<float>& policy,
+                       uint32_t* codes, float* weights) {
+        float top = -1e30f;
+        for (int i = 0; i < moves.count; i++) {
+            codes[i] = code(board, moves.masks[i]);
+            weights[i] = policy[codes[i]] + BIAS * __builtin_popcountll(moves.masks[i]);
+            top = std::max(top, weights[i]);
+        }
+        float total = 0;
+        for (int i = 0; i < moves.count; i++) {
+            weights[i] = std::exp(weights[i] - top);
+            total += weights[i];
+        }
+        return total;
+    }
+
+    // Adds new_states to the budget in batches, as a shared counter
+    // bumped after every playout would be contended.
+    void spend(Worker& w, uint64_t new_states, uint64_t batch = 0) {
+        w.states += new_states;
+        w.unspent += new_states;
+        if (w.unspent > batch) {
+            if (anytime.spend(w.unspent)) {
+                done = true;
+            }
+            w.unspent = 0;
+        }
+    }
+
+    // Plays board out with policy into line and returns the moves it
+    // takes to clear, counting the ending the tablebase knows.
+    int playout(Worker& w, PackedBoard board, const std::vector<float>& policy, Path& line) {
+        const Tablebase* tablebase = anytime.tablebase();
+        line.clear();
+        Groups buffers[2];
+        Groups* moves = &buffers[0];
+        Groups* next = &buffers[1];
+        board.groups(*moves);
+        uint64_t generated = moves->count;
+        uint32_t codes[MAX_SQUARES];
+        float weights[MAX_SQUARES];
+        int left = 0;
+        while (moves->count) {
+            if (tablebase && __builtin_popcountll(board.occupied()) <= tablebase->max_tiles()) {
+                left = tablebase->probe(board, board.hash());
+                if (left >= 0) {
+                    break;
+                }
+                left = 0;
+            }
+            float pick = weigh(board, *moves, policy, codes, weights)
+                * float((w.rng() >> 11) * 0x1.0p-53);
+            int i = 0;
+            while (i < moves->count - 1 && (pick -= weights[i]) >= 0) {
+                i++;
+            }
+            const Move mv = moves->masks[i];
+            line.push_back(PackedBoard::origin(mv));
+            board.remove(mv);
+            board.groups_after(*moves, mv, *next);
+            std::swap(moves, next);
+            generated += moves->count;
+        }
+        const int score = line.size() + left;
+        if (score < anytime.moves()) {
+            anytime.offer(line, left, source);
+            if (anytime.moves() <= lower) {
+                done = true;
+            }
+        }
+        spend(w, generated, 4096);
+        return score;
+    }
+
+    // Moves policy towards line: up by ALPHA for each move of the line, and
+    // every move of the same position down by ALPHA times its probability.
+    void adapt(Worker& w, PackedBoard board, std::vector<float>& policy, const Path& line) {
+        w.updates.clear();
+        Groups moves;
+        uint32_t codes[MAX_SQUARES];
+        float weights[MAX_SQUARES];
+        for (const uint8_t cell : line) {
+            board.groups(moves);
+            const float total = weigh(board, moves, policy, codes, weights);
+            const Move chosen = board.group_at(cell);
+            for (int i = 0; i < moves.count; i++) {
+                w.updates.emplace_back(codes[i], (moves.masks[i] == chosen) * ALPHA - ALPHA * weights[i] / total);
+            }
+            board.remove(chosen);
+        }
+        for (const auto& u : w.updates) {
+            policy[u.first] += u.second;
+        }
+    }
+
+    // Search of the given level from board with w.policies[level]; leaves
+    // its best line in w.lines[level] and returns its moves.
+    int nrpa(Worker& w, const PackedBoard& board, int level) {
+        std::vector<float>& policy = w.policies[level];
+        Path& best = w.lines[level];
+        int best_score = INT_MAX;
+        for (int i = 0; i < iterations && !done; i++) {
+            int score;
+            if (level == 1) {
+                score = playout(w, board, policy, w.lines[0]);
+            } else {
+                w.policies[level - 1] = policy;
+                score = nrpa(w, board, level - 1);
+            }
+            if (score <= best_score) {
+                best_score = score;
+                best = w.lines[level - 1];
+            }
+            adapt(w, board, policy, best);
+        }
+        return best_score;
+    }
+};
+
+// A game played one move at a time, with a hint asked for after each
+// move. Every line found is kept for every position along it (see
+// KnownLines), so playing the first move of a known line leaves the rest
+// of it as the next hint, with no search at all, and a search from a
+// position off those lines takes any position it reaches on one as
+// solved. Positions with more squares than the current one are dropped
+// as moves are played. The searches also share the transposition table,
+// which keeps the positions they searched without success.
+template<int W, int H>
+class BasicSession {
+public:
+    typedef BasicGame<W, H> Game;
+    typedef BasicPath<W, H> Path;
+    typedef BasicPackedBoard<W, H> PackedBoard;
+    typedef BasicAnytime<W, H> Anytime;
+    typedef BasicKnownLines<W, H> KnownLines;
+
+    // Of the search for a position with no known line and no budget.
+    SearchPolicy policy;
+
+    BasicSession(WorkStealingPool& workers, TranspositionTable& table, const PackedBoard& start,
+                 const Tablebase* endgames = nullptr)
+        : pool(workers), tt(table), tablebase(endgames), position(start) {}
+
+    const PackedBoard& board() const { return position; }
+    // States generated by all the session's searches.
+    uint64_t states() const { return total_states; }
+
+    // The shortest known line that clears the current position, empty if
+    // none is known.
+    Path known() const {
+        const Path* line = lines.find(position, position.hash());
+        return line ? *line : Path();
+    }
+
+    // A line that clears the current position, empty if none was found.
+    // Without a budget the known line is returned as it is, and only a
+    // position without one is searched, with policy. With one, the
+    // anytime search looks for shorter lines than the known one until the
+    // budget is spent, and keeps every improvement.
+    Path hint(double seconds = 0, uint64_t max_states = 0) {
+        if (!position.occupied()) {
+            return Path();
+        }
+        const Game root(position);
+        if (seconds <= 0 && max_states == 0) {
+            if (known().empty()) {
+                BasicParallelSearch<W, H> search(pool, tt, 2, nullptr, tablebase, &lines);
+                search.configure(policy);
+                search.search(root, policy.depth, policy.width);
+                total_states += search.states();
+                if (!search.solution.empty()) {
+                    lines.add(position, complete(position, search.solution, tablebase));
+                }
+            }
+            return known();
+        }
+        // The callback runs under the Anytime's lock while the searches
+        // read lines, so improvements are only added once they are done.
+        std::vector<Path> found;
+        Anytime anytime(position, seconds, max_states, [&found](const Path& line, double) {
+            found.push_back(line);
+        }, tablebase);
+        const Path start = known();
+        if (!start.empty()) {
+            anytime.offer(start, 0);
+        }
+        BasicAnytimeSearch<W, H> search(pool, tt, anytime, &lines);
+        search.configure(policy);
+        search.run(root);
+        total_states += search.states();
+        for (const Path& line : found) {
+            lines.add(position, line);
+        }
+        return known();
+    }
+
+    // Plays the move removing group mv.
+    void play(Move mv) {
+        position.remove(mv);
+        lines.drop_above(__builtin_popcountll(position.occupied()));
+    }
+
+    // Plays the move that turns the current position into next; false,
+    // changing nothing, if no move does.
+    bool advance(const PackedBoard& next) {
+        Groups moves;
+        position.groups(moves);
+        for (const Move mv : moves) {
+            PackedBoard child = position;
+            child.remove(mv);
+            if (child == next) {
+                play(mv);
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    WorkStealingPool& pool;
+    TranspositionTable& tt;
+    const Tablebase* tablebase;
+    PackedBoard position;
+    KnownLines lines;
+    uint64_t total_states = 0;
+};
+
+// One member of a Portfolio: an engine and its settings.
+struct Strategy {
+    enum Engine { GREEDY, BEAM, NRPA };
+    Engine engine = GREEDY;
+    SearchPolicy greedy;
+    std::size_t beam = 256;
+    int level = 3;         // nrpa
+
+    // Parses "greedy:DEPTH:WIDTH:PRUNE", "beam:K" or "nrpa:LEVEL", where
+    // settings left out keep their defaults.
+    static bool parse(const std::string& text, Strategy& out) {
+        out = Strategy();
+        std::vector<std::string> fields(1);
+        for (const char ch : text) {
+            if (ch == ':') {
+                fields.emplace_back();
+            } else {
+                fields.back() += ch;
+            }
+        }
+        try {
+            if (fields[0] == "greedy" && fields.size() <= 4) {
+                out.engine = GREEDY;
+                SearchPolicy& p = out.greedy;
+                p.depth = fields.size() > 1 ? std::stoi(fields[1]) : p.depth;
+                p.width = fields.size() > 2 ? std::stoul(fields[2]) : p.width;
+                p.prune = fields.size() > 3 ? std::stod(fields[3]) : p.prune;
+                if (!p.check().empty()) {
+                    return false;
+                }
+            } else if (fields[0] == "beam" && fields.size() <= 2) {
+                out.engine = BEAM;
+                out.beam = fields.size() > 1 ? std::stoul(fields[1]) : out.beam;
+            } else if (fields[0] == "nrpa" && fields.size() <= 2) {
+                out.engine = NRPA;
+                out.level = fields.size() > 1 ? std::stoi(fields[1]) : out.level;
+                if (out.level < 1) {
+                    return false;
+                }
+            } else {
+                return false;
+            }
+        } catch (const std::exception&) {
+            return false;
+        }
+        return true;
+    }
+
+    std::string name() const {
+        char text[64];
+        switch (engine) {
+        case GREEDY:
+            std::snprintf(text, sizeof(text), "greedy:%d:%zu:%g", greedy.depth, greedy.width, greedy.prune);
+            break;
+        case BEAM:
+            std::snprintf(text, sizeof(text), "beam:%zu", beam);
+            break;
+        case NRPA:
+            std::snprintf(text, sizeof(text), "nrpa:%d", level);
+            break;
+        }
+        return text;
+    }
+};
+
+// Parses a comma separated list of Strategy::parse() strings.
+inline bool parse_strategies(const std::string& text, std::vector<Strategy>& out) {
+    out.clear();
+    std::size_t start = 0;
+    while (start <= text.size()) {
+        std::size_t end = text.find(',', start);
+        end = end == std::string::npos ? text.size() : end;
+        Strategy strategy;
+        if (!Strategy::parse(text.substr(start, end - start), strategy)) {
+            return false;
+        }
+        out.push_back(strategy);
+        start = end + 1;
+    }
+    return true;
+}
+
+// The members a portfolio runs unless told otherwise.
+static const char* const DEFAULT_PORTFOLIO =
+    "greedy:12:12:3.6,greedy:14:8:3,greedy:12:12:4.5,beam:64,beam:512,nrpa:3";
+
+// Races several strategies on the same board, each on its own share of
+// the threads. They share an Anytime: every solution lowers the depth all
+// greedy members may still search, so they drop the lines that can no
+// longer win and finish early. With a budget the race runs until it is
+// spent or every member is done; without one, the first member to finish
+// with a solution ends it. The shared transposition table is what members
+// learn about positions from each other, as far as they prune alike.
+template<int W, int H>
+class BasicPortfolio {
+public:
+    typedef BasicGame<W, H> Game;
+    typedef BasicPath<W, H> Path;
+    typedef BasicAnytime<W, H> Anytime;
+
+    BasicPortfolio(int threads, TranspositionTable& table, Anytime& best, const std::vector<Strategy>& strategies)
+        : tt(table), anytime(best), members(strategies), counts(strategies.size()) {
+        // Threads are dealt out round robin, and every member has one even
+        // if there are more members than threads: threads is then a lower
+        // bound, and the system time-slices the members. Dropping members
+        // instead would lose the ones that finish first on hard boards.
+        const int n = std::max<int>(1, members.size());
+        for (int i = 0; i < n; i++) {
+            shares.push_back(std::max(1, threads / n + (i < threads % n)));
+        }
+    }
+
+    // Returns the best solution found, empty if none was; winner() then
+    // tells which member found it.
+    Path run(const Game& root) {
+        std::vector<std::thread> racers;
+        for (std::size_t i = 0; i < members.size(); i++) {
+            racers.emplace_back([this, &root, i] {
+                WorkStealingPool pool(shares[i]);
+                counts[i] = race(members[i], int(i), pool, root);
+                if (!anytime.bounded() && anytime.moves() < INT_MAX) {
+                    anytime.stop();
+                }
+            });
+        }
+        for (auto& t : racers) {
+            t.join();
+        }
+        return anytime.solution();
+    }
+
+    // Threads the members run on, at least one per member.
+    int threads() const {
+        int total = 0;
+        for (const int n : shares) {
+            total += n;
+        }
+        return total;
+    }
+
+    // Index in the strategies of the member that found the solution, -1
+    // if there is none.
+    int winner() const {
+        return anytime.source();
+    }
+
+    uint64_t states() const {
+        uint64_t total = 0;
+        for (const uint64_t n : counts) {
+            total += n;
+        }
+        return total;
+    }
+
+private:
+    TranspositionTable& tt;
+    Anytime& anytime;
+    const std::vector<Strategy> members;
+    std::vector<int> shares;
+    std::vector<uint64_t> counts;
+
+    // Runs one member to its end; returns the states it generated.
+    uint64_t race(const Strategy& strategy, int index, WorkStealingPool& pool, const Game& root) {
+        switch (strategy.engine) {
+        case Strategy::GREEDY: {
+            BasicParallelSearch<W, H> search(pool, tt, 2, &anytime, anytime.tablebase());
+            search.configure(strategy.greedy, index);
+            search.search(root, strategy.greedy.depth, strategy.greedy.width);
+            return search.states();
+        }
+        case Strategy::BEAM: {
+            BasicBeamSearch<W, H> search(pool, strategy.beam);
+            search.anytime = &anytime;
+            const Path line = search.search(root);
+            if (!line.empty()) {
+                anytime.offer(line, 0, index);
+            }
+            return search.states();
+        }
+        case Strategy::NRPA: {
+            BasicRolloutSearch<W, H> search(pool, anytime, strategy.level);
+            search.source = index;
+            search.run(root);
+            return search.states();
+        }
+        }
+        return 0;
+    }
+};
+
+typedef BasicPath<HSIZE, VSIZE> Path;
+typedef BasicGame<HSIZE, VSIZE> Game;
+typedef BasicNodeArena<HSIZE, VSIZE> NodeArena;
+typedef BasicAnytime<HSIZE, VSIZE> Anytime;
+typedef BasicSearch<HSIZE, VSIZE> Search;
+typedef BasicParallelSearch<HSIZE, VSIZE> ParallelSearch;
+typedef BasicExactSearch<HSIZE, VSIZE> ExactSearch;
+typedef BasicAnytimeSearch<HSIZE, VSIZE> AnytimeSearch;
+typedef BasicBeamSearch<HSIZE, VSIZE> BeamSearch;
+typedef BasicRolloutSearch<HSIZE, VSIZE> RolloutSearch;
+typedef BasicPortfolio<HSIZE, VSIZE> Portfolio;
+typedef BasicSession<HSIZE, VSIZE> Session;
@@ -0,0 +1,153 @@
+#pragma once
+#include <stdint-gcc.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iostream>
+#include "board.hpp"
+
+// Where a Search spends its nodes and time. Compiled in only with
+// -DSEARCH_STATS; otherwise every method is an empty inline function and
+// the collector costs nothing.
+#ifdef SEARCH_STATS
+class SearchStats {
+public:
+    static constexpr bool enabled = true;
+    static constexpr int PLIES = MAX_SQUARES;
+    enum Phase { MOVEGEN, SORT, PHASES };
+    typedef std::chrono::steady_clock Clock;
+    typedef Clock::time_point Timer;
+
+    // Counters per ply from the root.
+    struct Ply {
+        uint64_t expanded = 0;   // nodes whose children were generated
+        uint64_t generated = 0;  // children generated
+        uint64_t visited = 0;    // children within the width cap
+        uint64_t pruned = 0;     // visited children cut by the (depth+3)*3.6 rule
+        uint64_t solutions = 0;  // visited children with at most two groups
+        uint64_t tt_cutoffs = 0; // nodes skipped by a transposition table hit
+        uint64_t horizon = 0;    // nodes reached with no depth left
+    };
+
+    std::array<Ply, PLIES + 1> plies;
+    std::array<uint64_t, PLIES + 1> branching = {0}; // expanded nodes by move count
+    std::array<uint64_t, PHASES> phase_ns = {0};
+    uint64_t total_ns = 0;
+
+    void expand(int ply, int moves) {
+        plies[ply].expanded++;
+        plies[ply].generated += moves;
+        branching[moves]++;
+    }
+    void visit(int ply) { plies[ply].visited++; }
+    void prune(int ply) { plies[ply].pruned++; }
+    void solution(int ply) { plies[ply].solutions++; }
+    void tt_cutoff(int ply) { plies[ply].tt_cutoffs++; }
+    void horizon(int ply) { plies[ply].horizon++; }
+
+    Timer start() const { return Clock::now(); }
+    void stop(Phase phase, Timer& t) {
+        const Timer now = Clock::now();
+        phase_ns[phase] += std::chrono::duration_cast<std::chrono::nanoseconds>(now - t).count();
+        t = now;
+    }
+
+    // Times the outermost search() call only, so nested calls are not
+    // counted twice.
+    class Scope {
+    public:
+        Scope(SearchStats& s) : stats(s), t(s.nesting++ ? Timer() : Clock::now()) {}
+        ~Scope() {
+            if (--stats.nesting == 0) {
+                stats.total_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t).count();
+            }
+        }
+    private:
+        SearchStats& stats;
+        Timer t;
+    };
+
+    SearchStats& operator+=(const SearchStats& rh) {
+        for (int i = 0; i <= PLIES; i++) {
+            plies[i].expanded += rh.plies[i].expanded;
+            plies[i].generated += rh.plies[i].generated;
+            plies[i].visited += rh.plies[i].visited;
+            plies[i].pruned += rh.plies[i].pruned;
+            plies[i].solutions += rh.plies[i].solutions;
+            plies[i].tt_cutoffs += rh.plies[i].tt_cutoffs;
+            plies[i].horizon += rh.plies[i].horizon;
+            branching[i] += rh.branching[i];
+        }
+        for (int p = 0; p < PHASES; p++) {
+            phase_ns[p] += rh.phase_ns[p];
+        }
+        total_ns += rh.total_ns;
+        return *this;
+    }
+
+    void print_json(std::ostream& os) const {
+        uint64_t expanded = 0, generated = 0;
+        for (const Ply& p : plies) {
+            expanded += p.expanded;
+            generated += p.generated;
+        }
+        const uint64_t other = total_ns - std::min(total_ns, phase_ns[MOVEGEN] + phase_ns[SORT]);
+        os << "{\n  \"enabled\": true,\n  \"expanded\": " << expanded << ",\n  \"generated\": " << generated
+           << ",\n  \"time_ns\": {\"total\": " << total_ns << ", \"movegen\": " << phase_ns[MOVEGEN]
+           << ", \"sort\": " << phase_ns[SORT] << ", \"other\": " << other << "},\n  \"plies\": [";
+        const char* sep = "\n";
+        for (int i = 0; i <= PLIES; i++) {
+            const Ply& p = plies[i];
+            if (!p.expanded && !p.tt_cutoffs && !p.horizon) {
+                continue;
+            }
+            os << sep << "    {\"ply\": " << i << ", \"expanded\": " << p.expanded
+               << ", \"generated\": " << p.generated << ", \"visited\": " << p.visited
+               << ", \"capped\": " << p.generated - p.visited << ", \"pruned\": " << p.pruned
+               << ", \"solutions\": " << p.solutions << ", \"tt_cutoffs\": " << p.tt_cutoffs
+               << ", \"horizon\": " << p.horizon << "}";
+            sep = ",\n";
+        }
+        os << "\n  ],\n  \"branching\": {\"mean\": " << (expanded ? double(generated) / expanded : 0)
+           << ", \"histogram\": {";
+        sep = "";
+        for (int i = 0; i <= PLIES; i++) {
+            if (branching[i]) {
+                os << sep << "\"" << i << "\": " << branching[i];
+                sep = ", ";
+            }
+        }
+        os << "}}\n}\n";
+    }
+
+private:
+    int nesting = 0;
+};
+#else
+class SearchStats {
+public:
+    static constexpr bool enabled = false;
+    enum Phase { MOVEGEN, SORT, PHASES };
+    struct Timer {};
+
+    void expand(int, int) {}
+    void visit(int) {}
+    void prune(int) {}
+    void solution(int) {}
+    void tt_cutoff(int) {}
+    void horizon(int) {}
+    Timer start() const { return Timer(); }
+    void stop(Phase, Timer&) {}
+
+    class Scope {
+    public:
+        Scope(SearchStats&) {}
+    };
+
+    SearchStats& operator+=(const SearchStats&) { return *this; }
+
+    void print_json(std::ostream& os) const {
+        os << "{\"enabled\": false}\n";
+    }
+};
+#endif
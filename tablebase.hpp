@@ -0,0 +1,151 @@
+#pragma once
+#include <stdint-gcc.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "board.hpp"
+
+// Endgame tablebase: the exact number of moves that clears every position
+// of one board size with at most max_tiles squares, written by tbgen and
+// memory mapped by the solver. Positions are keyed like the transposition
+// table, min(hash, mirror_hash), so a position and its mirror image share
+// an entry. The file is a TablebaseHeader, then the keys in ascending
+// order as uint64_t, then one uint8_t value per key in the same order.
+struct TablebaseHeader {
+    char magic[8];
+    uint32_t width;
+    uint32_t height;
+    uint32_t max_tiles;
+    uint32_t reserved;
+    uint64_t count;
+};
+
+static constexpr char TABLEBASE_MAGIC[8] = {'F', 'O', 'R', 'M', 'T', 'B', '1', 0};
+
+class Tablebase {
+public:
+    typedef std::pair<uint64_t, uint8_t> Entry;
+
+    // Maps path read only. Throws std::runtime_error if it cannot be read
+    // or holds the tablebase of another board size.
+    Tablebase(const std::string& path, int width, int height) {
+        const int fd = open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            throw std::runtime_error("Failed to open tablebase " + path);
+        }
+        length = st.st_size;
+        void* data = length ? mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+        close(fd);
+        if (data == MAP_FAILED) {
+            throw std::runtime_error("Failed to map tablebase " + path);
+        }
+        base = static_cast<const uint8_t*>(data);
+        const TablebaseHeader* header = reinterpret_cast<const TablebaseHeader*>(base);
+        if (length < sizeof(TablebaseHeader) || std::memcmp(header->magic, TABLEBASE_MAGIC, 8) != 0
+            || length != sizeof(TablebaseHeader) + header->count * (sizeof(uint64_t) + 1)) {
+            munmap(const_cast<uint8_t*>(base), length);
+            throw std::runtime_error(path + " is not a tablebase");
+        }
+        if (int(header->width) != width || int(header->height) != height) {
+            const std::string size = std::to_string(header->width) + "x" + std::to_string(header->height);
+            munmap(const_cast<uint8_t*>(base), length);
+            throw std::runtime_error(path + " is for " + size + " boards");
+        }
+        tiles = header->max_tiles;
+        count = header->count;
+        keys = reinterpret_cast<const uint64_t*>(base + sizeof(TablebaseHeader));
+        values = base + sizeof(TablebaseHeader) + count * sizeof(uint64_t);
+    }
+
+    ~Tablebase() {
+        munmap(const_cast<uint8_t*>(base), length);
+    }
+
+    Tablebase(const Tablebase&) = delete;
+    Tablebase& operator=(const Tablebase&) = delete;
+
+    int max_tiles() const { return tiles; }
+    std::size_t size() const { return count; }
+
+    // Moves needed to clear the position with this key, -1 if it is not
+    // in the table.
+    int find(uint64_t key) const {
+        const uint64_t* it = std::lower_bound(keys, keys + count, key);
+        return it != keys + count && *it == key ? values[it - keys] : -1;
+    }
+
+    // Moves needed to clear board, whose hash() is hash; -1 if the board
+    // has more than max_tiles() squares.
+    template<int W, int H>
+    int probe(const BasicPackedBoard<W, H>& board, uint64_t hash) const {
+        const int squares = __builtin_popcountll(board.occupied());
+        if (squares == 0) {
+            return 0;
+        }
+        if (squares > tiles) {
+            return -1;
+        }
+        return find(std::min(hash, board.mirror_hash()));
+    }
+
+    // A move of an optimal solution of board, 0 if the board is empty or
+    // has more than max_tiles() squares.
+    template<int W, int H>
+    Move best_move(const BasicPackedBoard<W, H>& board) const {
+        const int moves = probe(board, board.hash());
+        if (moves <= 0) {
+            return 0;
+        }
+        Groups groups;
+        board.groups(groups);
+        for (const Move mv : groups) {
+            BasicPackedBoard<W, H> child = board;
+            child.remove(mv);
+            if (probe(child, child.hash()) == moves - 1) {
+                return mv;
+            }
+        }
+        return 0;
+    }
+
+    // Writes entries, sorted by key, as the tablebase of a width x height
+    // board. False if the file cannot be written.
+    static bool write(const std::string& path, int width, int height, int max_tiles,
+                      const std::vector<Entry>& entries) {
+        std::ofstream out(path, std::ios::binary);
+        TablebaseHeader header = {};
+        std::memcpy(header.magic, TABLEBASE_MAGIC, 8);
+        header.width = width;
+        header.height = height;
+        header.max_tiles = max_tiles;
+        header.count = entries.size();
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const Entry& e : entries) {
+            out.write(reinterpret_cast<const char*>(&e.first), sizeof(e.first));
+        }
+        for (const Entry& e : entries) {
+            out.put(e.second);
+        }
+        return bool(out);
+    }
+
+private:
+    const uint8_t* base = nullptr;
+    std::size_t length = 0;
+    int tiles = 0;
+    std::size_t count = 0;
+    const uint64_t* keys = nullptr;
+    const uint8_t* values = nullptr;
+};
@@ -0,0 +1,154 @@
+#include <stdint-gcc.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "board.hpp"
+#include "tablebase.hpp"
+
+// Generates the endgame tablebase the solver probes with --tablebase:
+//   build/tbgen --size 7x9 --tiles 6 tb7x9.bin
+// Every move removes squares, so positions are solved by their number of
+// squares, fewest first: a position takes one move more than its best
+// child, and all children are already solved.
+
+typedef std::vector<Tablebase::Entry> Level;
+
+// Calls f with every fallen W x H board of exactly n squares: each way to
+// share them out between the columns, with every coloring.
+template<int W, int H, class F>
+static void each_position(int n, F f) {
+    typedef BasicPackedBoard<W, H> PackedBoard;
+    std::array<int, W> heights = {0};
+    auto color = [&](auto&& self, PackedBoard& board, int x, int y) -> void {
+        if (x == W) {
+            f(board);
+            return;
+        }
+        if (y == heights[x]) {
+            self(self, board, x + 1, 0);
+            return;
+        }
+        for (int c = 0; c < PackedBoard::COLORS; c++) {
+            board.planes[c] |= 1ull << (x * H + y);
+            self(self, board, x, y + 1);
+            board.planes[c] &= ~(1ull << (x * H + y));
+        }
+    };
+    auto share = [&](auto&& self, int x, int left) -> void {
+        if (x == W - 1) {
+            if (left <= H) {
+                heights[x] = left;
+                PackedBoard board;
+                color(color, board, 0, 0);
+            }
+            return;
+        }
+        for (int h = 0; h <= std::min(left, H); h++) {
+            heights[x] = h;
+            self(self, x + 1, left - h);
+        }
+    };
+    share(share, 0, n);
+}
+
+static int find(const Level& level, uint64_t key) {
+    const auto it = std::lower_bound(level.begin(), level.end(), Tablebase::Entry(key, 0));
+    return it != level.end() && it->first == key ? it->second : -1;
+}
+
+template<int W, int H>
+static int generate(int max_tiles, const std::string& path) {
+    typedef BasicPackedBoard<W, H> PackedBoard;
+    std::vector<Level> levels(max_tiles + 1);
+    std::size_t total = 0;
+    const auto start_time = std::chrono::steady_clock::now();
+    for (int n = 1; n <= max_tiles; n++) {
+        Level& level = levels[n];
+        each_position<W, H>(n, [&](const PackedBoard& board) {
+            // Mirror images share an entry, so only the canonical one of
+            // each pair is solved.
+            if (board.mirrored().planes < board.planes) {
+                return;
+            }
+            Groups moves;
+            board.groups(moves);
+            int best = 255;
+            for (const Move mv : moves) {
+                PackedBoard child = board;
+                child.remove(mv);
+                const int left = n - __builtin_popcountll(mv);
+                const int value = left == 0 ? 0 : find(levels[left], std::min(child.hash(), child.mirror_hash()));
+                best = std::min(best, value);
+            }
+            level.emplace_back(std::min(board.hash(), board.mirror_hash()), 1 + best);
+        });
+        std::sort(level.begin(), level.end());
+        total += level.size();
+        const std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start_time;
+        std::cout << n << " squares: " << level.size() << " positions (" << secs.count() << " s)" << std::endl;
+    }
+
+    Level entries;
+    entries.reserve(total);
+    for (const Level& level : levels) {
+        entries.insert(entries.end(), level.begin(), level.end());
+    }
+    std::sort(entries.begin(), entries.end());
+    for (std::size_t i = 1; i < entries.size(); i++) {
+        if (entries[i].first == entries[i - 1].first) {
+            std::cerr << "Two positions share the key " << entries[i].first << ", not written\n";
+            return 1;
+        }
+    }
+    if (!Tablebase::write(path, W, H, max_tiles, entries)) {
+        std::cerr << "Failed to write " << path << "\n";
+        return 1;
+    }
+    std::cout << "Wrote " << entries.size() << " positions of up to " << max_tiles << " squares to "
+              << path << std::endl;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int size_w = HSIZE;
+    int size_h = VSIZE;
+    int tiles = 6;
+    std::string path;
+    // Numbers that do not parse leave path empty, for the usage below.
+    int i = 1;
+    try {
+        for (; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--size" && i + 1 < argc) {
+                if (std::sscanf(argv[++i], "%dx%d", &size_w, &size_h) != 2) {
+                    size_w = size_h = 0;
+                }
+            } else if (arg == "--tiles" && i + 1 < argc) {
+                tiles = std::stoi(argv[++i]);
+            } else if (path.empty() && arg[0] != '-') {
+                path = arg;
+            } else {
+                path.clear();
+                break;
+            }
+        }
+    } catch (const std::exception&) {
+        std::cerr << "Bad value for " << argv[i - 1] << ": " << argv[i] << "\n";
+        path.clear();
+    }
+    if (path.empty() || tiles < 1) {
+        std::cerr << "Usage: " << argv[0] << " [--size WxH] [--tiles N] <output file>\n";
+        return 1;
+    }
+    int status = 1;
+    const bool known = with_board_size(size_w, size_h, [&](auto size) {
+        status = generate<size.width, size.height>(std::min(tiles, size.width * size.height), path);
+    });
+    if (!known) {
+        std::cerr << "No solver for " << size_w << "x" << size_h << " boards, sizes are " << BOARD_SIZES << "\n";
+    }
+    return status;
+}
@@ -0,0 +1,147 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of workers, each with its own task deque. A worker pops its
+// newest task (depth first through the tree it is splitting) and, when
+// empty, steals the oldest task of another worker (the biggest subtree).
+class WorkStealingPool {
+public:
+    typedef std::function<void()> Task;
+
+    explicit WorkStealingPool(int threads) {
+        if (threads < 1) {
+            threads = 1;
+        }
+        for (int i = 0; i < threads; i++) {
+            queues.emplace_back(new Queue);
+        }
+        for (int i = 0; i < threads; i++) {
+            workers.emplace_back([this, i] { run(i); });
+        }
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(idle_mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& t : workers) {
+            t.join();
+        }
+    }
+
+    int size() const {
+        return workers.size();
+    }
+
+    // Index of the calling worker of this pool, -1 for any other thread.
+    int worker_index() const {
+        return current_pool == this ? current_index : -1;
+    }
+
+    // Queues on the calling worker's deque. Tasks from outside the pool go
+    // round robin to the far end of the deques, so they start in the order
+    // they were submitted.
+    void submit(Task task) {
+        int index = worker_index();
+        const bool outside = index < 0;
+        if (outside) {
+            index = next_queue++ % queues.size();
+        }
+        pending++;
+        {
+            std::lock_guard<std::mutex> lock(queues[index]->mutex);
+            if (outside) {
+                queues[index]->tasks.push_front(std::move(task));
+            } else {
+                queues[index]->tasks.push_back(std::move(task));
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(idle_mutex);
+            queued++;
+        }
+        wake.notify_one();
+    }
+
+    // Blocks until every submitted task, including the ones they submitted,
+    // has run. Must not be called from a worker.
+    void wait() {
+        std::unique_lock<std::mutex> lock(idle_mutex);
+        finished.wait(lock, [this] { return pending == 0; });
+    }
+
+private:
+    struct alignas(64) Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<int> pending{0};
+    std::atomic<int> queued{0};
+    std::atomic<unsigned> next_queue{0};
+    std::mutex idle_mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    bool stopping = false;
+
+    static thread_local const WorkStealingPool* current_pool;
+    static thread_local int current_index;
+
+    bool try_pop(int index, Task& task) {
+        {
+            Queue& own = *queues[index];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+        for (std::size_t i = 1; i < queues.size(); i++) {
+            Queue& victim = *queues[(index + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run(int index) {
+        current_pool = this;
+        current_index = index;
+        while (true) {
+            Task task;
+            if (try_pop(index, task)) {
+                queued--;
+                task();
+                if (--pending == 0) {
+                    std::lock_guard<std::mutex> lock(idle_mutex);
+                    finished.notify_all();
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(idle_mutex);
+            wake.wait(lock, [this] { return stopping || queued > 0; });
+            if (stopping) {
+                return;
+            }
+        }
+    }
+};
+
+inline thread_local const WorkStealingPool* WorkStealingPool::current_pool = nullptr;
+inline thread_local int WorkStealingPool::current_index = -1;
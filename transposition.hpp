@@ -0,0 +1,166 @@
+#pragma once
+#include <stdint-gcc.h>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <iostream>
+
+// Counters are kept by each searcher and summed afterwards, so threads
+// sharing a table never write to the same counter.
+struct TTStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t collisions = 0;
+
+    TTStats& operator+=(const TTStats& rh) {
+        hits += rh.hits;
+        misses += rh.misses;
+        collisions += rh.collisions;
+        return *this;
+    }
+};
+
+// What the search learned about one position: either it was searched with
+// this remaining depth and width without reaching a solution, under the
+// pruning rule tagged rule, or (BOUND) depth holds a lower bound on the
+// moves needed to clear it. Depth and width are capped at 255, so a stored
+// 255 means at least 255. The key is
+// stored xor'ed with the data, so an entry torn by two threads writing it
+// at once fails the key check instead of returning mixed data.
+struct TTEntry {
+    std::atomic<uint64_t> check{0};
+    std::atomic<uint64_t> data{0};
+
+    static constexpr uint64_t USED = 1ull << 24;
+    static constexpr uint64_t BOUND = 1ull << 25;
+
+    static constexpr std::size_t MAX = 0xff;
+
+    static uint64_t pack(int depth, std::size_t width, uint16_t rule, uint8_t generation) {
+        return USED | (uint64_t(rule) << 32) | (uint64_t(generation) << 16) | (uint64_t(std::min(width, MAX)) << 8)
+             | uint64_t(std::min<std::size_t>(depth, MAX));
+    }
+    static int depth(uint64_t d) { return d & 0xff; }
+    static std::size_t width(uint64_t d) { return (d >> 8) & 0xff; }
+    static uint8_t generation(uint64_t d) { return (d >> 16) & 0xff; }
+    static uint16_t rule(uint64_t d) { return (d >> 32) & 0xffff; }
+};
+
+// Four entries fill one 64 byte cache line, so a probe touches one line.
+struct alignas(64) TTBucket {
+    static constexpr int WAYS = 4;
+    TTEntry entries[WAYS];
+};
+
+class TranspositionTable {
+public:
+    // Largest size accepted by the programs' --tt-mb (1 TB).
+    static constexpr std::size_t MAX_MEGABYTES = std::size_t(1) << 20;
+
+    // Size is rounded down to a power of two number of buckets, and
+    // clamped to MAX_MEGABYTES.
+    TranspositionTable(std::size_t megabytes) {
+        const std::size_t bytes = std::min(megabytes, MAX_MEGABYTES) << 20;
+        std::size_t buckets = 1;
+        while (buckets <= bytes / 2 / sizeof(TTBucket)) {
+            buckets *= 2;
+        }
+        table.reset(new TTBucket[buckets]);
+        mask = buckets - 1;
+    }
+
+    std::size_t size_bytes() const {
+        return (mask + 1) * sizeof(TTBucket);
+    }
+
+    // Starts a new search; older entries become the first to be replaced.
+    void new_generation() {
+        generation++;
+    }
+
+    // True if key was already searched at least this deep and wide, under
+    // the same pruning rule, and failed, so searching it again cannot find
+    // anything new. A search that prunes less could still succeed there.
+    bool probe(uint64_t key, int depth, std::size_t width, uint16_t rule, TTStats& stats) const {
+        const uint64_t d = find(key, 0, stats);
+        return d && TTEntry::rule(d) == rule && TTEntry::depth(d) >= depth && TTEntry::width(d) >= width;
+    }
+
+    void store(uint64_t key, int depth, std::size_t width, uint16_t rule, TTStats& stats) {
+        write(key, TTEntry::pack(depth, width, rule, generation), stats);
+    }
+
+    // Lower bound on the moves needed to clear key's board, 0 if unknown.
+    int probe_bound(uint64_t key, TTStats& stats) const {
+        return TTEntry::depth(find(key, TTEntry::BOUND, stats));
+    }
+
+    void store_bound(uint64_t key, int bound, TTStats& stats) {
+        write(key, TTEntry::pack(bound, 0, 0, generation) | TTEntry::BOUND, stats);
+    }
+
+    void print_stats(std::ostream& os, const TTStats& stats) const {
+        os << "Transposition table: " << (size_bytes() >> 20) << " MB, "
+           << stats.hits << " hits, " << stats.misses << " misses, "
+           << stats.collisions << " collisions\n";
+    }
+
+private:
+    std::unique_ptr<TTBucket[]> table;
+    uint64_t mask;
+    uint8_t generation = 0;
+
+    // Data of key's entry of the given kind, 0 if there is none.
+    uint64_t find(uint64_t key, uint64_t kind, TTStats& stats) const {
+        const TTBucket& bucket = table[key & mask];
+        for (const TTEntry& e : bucket.entries) {
+            const uint64_t d = e.data.load(std::memory_order_relaxed);
+            if ((e.check.load(std::memory_order_relaxed) ^ d) == key && (d & TTEntry::USED)) {
+                if ((d & TTEntry::BOUND) != kind) {
+                    break;
+                }
+                stats.hits++;
+                return d;
+            }
+        }
+        stats.misses++;
+        return 0;
+    }
+
+    // Replaces, in order of preference: the same key, an empty slot, or the
+    // shallowest entry, where entries from older searches count as empty.
+    // An entry of the same kind and rule that already says more is kept.
+    void write(uint64_t key, uint64_t data, TTStats& stats) {
+        TTBucket& bucket = table[key & mask];
+        TTEntry* victim = nullptr;
+        bool same_key = false;
+        int victim_score = 1 << 30;
+        for (TTEntry& e : bucket.entries) {
+            const uint64_t d = e.data.load(std::memory_order_relaxed);
+            if ((e.check.load(std::memory_order_relaxed) ^ d) == key && (d & TTEntry::USED)) {
+                if ((d & TTEntry::BOUND) == (data & TTEntry::BOUND)
+                    && TTEntry::rule(d) == TTEntry::rule(data)
+                    && TTEntry::depth(d) > TTEntry::depth(data)
+                    && TTEntry::width(d) >= TTEntry::width(data)) {
+                    return;
+                }
+                victim = &e;
+                same_key = true;
+                break;
+            }
+            const int score = !(d & TTEntry::USED) ? -1
+                            : TTEntry::generation(d) != generation ? 0
+                            : TTEntry::depth(d) + 1;
+            if (score < victim_score) {
+                victim = &e;
+                victim_score = score;
+            }
+        }
+        if (!same_key && victim_score >= 0) {
+            stats.collisions++;
+        }
+        victim->data.store(data, std::memory_order_relaxed);
+        victim->check.store(key ^ data, std::memory_order_relaxed);
+    }
+};
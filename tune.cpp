@@ -0,0 +1,270 @@
+#include <stdint-gcc.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "board.hpp"
+#include "search.hpp"
+
+// Tunes the depth first search's SearchPolicy on a corpus of boards, one
+// per line in the batch format, and writes the best one for --policy:
+//   build/tune --trials 50 --board-ms 1000 --out policy.txt boards.txt
+// Every trial solves the whole corpus with one policy, each board stopped
+// after board-ms, and costs its total moves, plus W * H / 2 moves for
+// each board left unsolved, plus second-cost moves per CPU second spent.
+// The first trial is the starting policy; after that, most trials change
+// the best policy so far by a random step, which grows after an
+// improvement and shrinks after a failure, and every fourth is drawn at
+// random from the whole range so the search does not stay in one corner.
+
+struct Trial {
+    SearchPolicy policy;
+    int solved = 0;
+    int moves = 0;
+    double cpu_seconds = 0;
+    double cost = 0;
+};
+
+// Stops search once seconds have passed, unless it finished before.
+class Watchdog {
+public:
+    Watchdog(std::atomic<bool>& flag, double seconds)
+        : thread([this, &flag, seconds] {
+              std::unique_lock<std::mutex> lock(mutex);
+              if (!finished.wait_for(lock, std::chrono::duration<double>(seconds), [this] { return over; })) {
+                  flag = true;
+              }
+          }) {}
+
+    ~Watchdog() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            over = true;
+        }
+        finished.notify_one();
+        thread.join();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable finished;
+    bool over = false;
+    std::thread thread;
+};
+
+template<int W, int H>
+static Trial evaluate(const std::vector<BasicPackedBoard<W, H>>& corpus, const SearchPolicy& policy,
+                      WorkStealingPool& pool, std::size_t tt_mb, double board_seconds, double second_cost) {
+    Trial t;
+    t.policy = policy;
+    // A fresh table, so no trial profits from what an earlier one learned.
+    TranspositionTable tt(tt_mb);
+    const std::clock_t start = std::clock();
+    for (const BasicPackedBoard<W, H>& board : corpus) {
+        BasicParallelSearch<W, H> search(pool, tt, 2);
+        search.configure(policy);
+        {
+            Watchdog watchdog(search.done, board_seconds);
+            search.search(BasicGame<W, H>(board), policy.depth, policy.width);
+        }
+        if (search.solution.empty()) {
+            t.moves += W * H / 2;
+        } else {
+            t.solved++;
+            t.moves += complete(board, search.solution).size();
+        }
+    }
+    t.cpu_seconds = double(std::clock() - start) / CLOCKS_PER_SEC;
+    t.cost = t.moves + second_cost * t.cpu_seconds;
+    return t;
+}
+
+// Keeps policy within POLICY_RANGES, with min_width at most width.
+static SearchPolicy clamp(SearchPolicy p) {
+    for (int i = 0; i < SearchPolicy::SETTINGS; i++) {
+        const PolicyRange& r = POLICY_RANGES[i];
+        p.set(i, std::max(r.min, std::min(r.max, p.get(i))));
+    }
+    p.min_width = std::min(p.width, p.min_width);
+    return p;
+}
+
+// Best plus a normal step of step times each setting's range.
+static SearchPolicy perturb(const SearchPolicy& best, double step, std::mt19937_64& rng) {
+    std::normal_distribution<double> normal(0, step);
+    SearchPolicy p = best;
+    for (int i = 0; i < SearchPolicy::SETTINGS; i++) {
+        const PolicyRange& r = POLICY_RANGES[i];
+        // Clamped before set, which cannot store a negative width.
+        p.set(i, std::max(r.min, std::min(r.max, p.get(i) + normal(rng) * (r.max - r.min))));
+    }
+    return clamp(p);
+}
+
+// Uniform over POLICY_RANGES; min_width is drawn up to width.
+static SearchPolicy sample(std::mt19937_64& rng) {
+    std::uniform_real_distribution<double> unit(0, 1);
+    SearchPolicy p;
+    for (int i = 0; i < SearchPolicy::SETTINGS; i++) {
+        const PolicyRange& r = POLICY_RANGES[i];
+        const double max = i == SearchPolicy::MIN_WIDTH ? p.get(SearchPolicy::WIDTH) : r.max;
+        p.set(i, r.integer ? r.min + std::floor(unit(rng) * (max - r.min + 1))
+                           : r.min + unit(rng) * (max - r.min));
+    }
+    return clamp(p);
+}
+
+static void print(std::ostream& os, int index, const Trial& t, std::size_t boards) {
+    char line[200];
+    snprintf(line, sizeof(line),
+             "trial %3d: depth %2d width %2zu min_width %2zu prune_offset %5.2f prune %5.2f: "
+             "%d/%zu solved, %d moves, %.2f cpu s, cost %.1f",
+             index, t.policy.depth, t.policy.width, t.policy.min_width, t.policy.prune_offset,
+             t.policy.prune, t.solved, boards, t.moves, t.cpu_seconds, t.cost);
+    os << line << std::endl;
+}
+
+template<int W, int H>
+static int tune(const std::string& corpus_file, const SearchPolicy& start, int trials, int threads,
+                std::size_t tt_mb, double board_seconds, double second_cost, uint64_t seed,
+                const std::string& out_file) {
+    std::ifstream in(corpus_file);
+    if (!in) {
+        std::cerr << "Failed to open " << corpus_file << "\n";
+        return 1;
+    }
+    std::vector<BasicPackedBoard<W, H>> corpus;
+    std::string text;
+    for (int line_no = 1; std::getline(in, text); line_no++) {
+        if (text.empty() || text[0] == '#') {
+            continue;
+        }
+        BasicPackedBoard<W, H> board;
+        if (!parse_board(text, board)) {
+            std::cerr << "Line " << line_no << ": expected " << W * H
+                      << " fallen squares of \"-RGBY\", skipped\n";
+            continue;
+        }
+        corpus.push_back(board);
+    }
+    if (corpus.empty()) {
+        std::cerr << "No boards in " << corpus_file << "\n";
+        return 1;
+    }
+
+    WorkStealingPool pool(threads);
+    std::mt19937_64 rng(seed);
+    Trial best = evaluate(corpus, clamp(start), pool, tt_mb, board_seconds, second_cost);
+    print(std::cout, 0, best, corpus.size());
+    int best_index = 0;
+    double step = 0.1;
+    for (int i = 1; i < trials; i++) {
+        const bool wide = i % 4 == 0;
+        const SearchPolicy policy = wide ? sample(rng) : perturb(best.policy, step, rng);
+        const Trial t = evaluate(corpus, policy, pool, tt_mb, board_seconds, second_cost);
+        print(std::cout, i, t, corpus.size());
+        if (t.cost < best.cost) {
+            best = t;
+            best_index = i;
+            step = std::min(0.5, step * 1.5);
+        } else if (!wide) {
+            step = std::max(0.01, step * 0.9);
+        }
+    }
+
+    std::ofstream out(out_file);
+    out << "# Tuned on " << corpus.size() << " boards of " << corpus_file << ", " << board_seconds
+        << " s per board, " << second_cost << " moves per cpu second: " << best.solved << " solved, "
+        << best.moves << " moves, " << best.cpu_seconds << " cpu s\n";
+    best.policy.write(out);
+    if (!out) {
+        std::cerr << "Failed to write " << out_file << "\n";
+        return 1;
+    }
+    std::cout << "Best ";
+    print(std::cout, best_index, best, corpus.size());
+    std::cout << "Wrote " << out_file << std::endl;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int size_w = HSIZE;
+    int size_h = VSIZE;
+    int trials = 30;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    std::size_t tt_mb = 64;
+    double board_ms = 1000;
+    double second_cost = 1;
+    uint64_t seed = 1;
+    std::string out_file = "policy.txt";
+    std::string corpus;
+    SearchPolicy start;
+    // Numbers that do not parse leave corpus empty, for the usage below.
+    int i = 1;
+    try {
+        for (; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--size" && i + 1 < argc) {
+                if (std::sscanf(argv[++i], "%dx%d", &size_w, &size_h) != 2) {
+                    size_w = size_h = 0;
+                }
+            } else if (arg == "--trials" && i + 1 < argc) {
+                trials = std::max(1, std::stoi(argv[++i]));
+            } else if (arg == "--threads" && i + 1 < argc) {
+                threads = std::stoi(argv[++i]);
+            } else if (arg == "--tt-mb" && i + 1 < argc) {
+                tt_mb = std::stoul(argv[++i]);
+            } else if (arg == "--board-ms" && i + 1 < argc) {
+                board_ms = std::stod(argv[++i]);
+            } else if (arg == "--second-cost" && i + 1 < argc) {
+                second_cost = std::stod(argv[++i]);
+            } else if (arg == "--seed" && i + 1 < argc) {
+                seed = std::stoull(argv[++i]);
+            } else if (arg == "--out" && i + 1 < argc) {
+                out_file = argv[++i];
+            } else if (arg == "--policy" && i + 1 < argc) {
+                std::ifstream in(argv[++i]);
+                std::string error;
+                if (!in || !start.read(in, error)) {
+                    std::cerr << "Failed to read the policy in " << argv[i] << "\n";
+                    return 1;
+                }
+            } else if (corpus.empty() && arg[0] != '-') {
+                corpus = arg;
+            } else {
+                corpus.clear();
+                break;
+            }
+        }
+    } catch (const std::exception&) {
+        std::cerr << "Bad value for " << argv[i - 1] << ": " << argv[i] << "\n";
+        corpus.clear();
+    }
+    if (corpus.empty() || threads < 1) {
+        std::cerr << "Usage: " << argv[0] << " [--size WxH] [--trials N] [--board-ms N] [--second-cost MOVES]"
+                  << " [--threads N] [--tt-mb N] [--seed N] [--policy FILE] [--out FILE] <corpus>\n";
+        return 1;
+    }
+    if (tt_mb < 1 || tt_mb > TranspositionTable::MAX_MEGABYTES) {
+        std::cerr << "--tt-mb must be between 1 and " << TranspositionTable::MAX_MEGABYTES << "\n";
+        return 1;
+    }
+    int status = 1;
+    const bool known = with_board_size(size_w, size_h, [&](auto size) {
+        status = tune<size.width, size.height>(corpus, start, trials, threads, tt_mb, board_ms / 1000,
+                                               second_cost, seed, out_file);
+    });
+    if (!known) {
+        std::cerr << "No solver for " << size_w << "x" << size_h << " boards, sizes are " << BOARD_SIZES << "\n";
+    }
+    return status;
+}